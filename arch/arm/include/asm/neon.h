@@ -0,0 +1,26 @@
+/*
+ * linux/arch/arm/include/asm/neon.h
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef __ASM_ARM_NEON_H
+#define __ASM_ARM_NEON_H
+
+#include <asm/hwcap.h>
+
+#define cpu_has_neon()		(!!(elf_hwcap & HWCAP_NEON))
+
+/*
+ * Kernel mode NEON: the code between kernel_neon_begin() and
+ * kernel_neon_end() may use the NEON/VFP registers.  The user state held
+ * in the hardware is saved first, and preemption stays disabled until
+ * kernel_neon_end(), so the section must not sleep.  Not usable from
+ * interrupt context.
+ */
+void kernel_neon_begin(void);
+void kernel_neon_end(void);
+
+#endif /* __ASM_ARM_NEON_H */
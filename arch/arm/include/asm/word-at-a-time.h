@@ -0,0 +1,89 @@
+#ifndef __ASM_ARM_WORD_AT_A_TIME_H
+#define __ASM_ARM_WORD_AT_A_TIME_H
+
+/*
+ * Word-at-a-time zero byte detection for the string functions.
+ *
+ *	if (has_zero(val, &bits, &constants)) {
+ *		bits = prep_zero_mask(val, bits, &constants);
+ *		index = find_zero(create_zero_mask(bits));
+ *	}
+ *
+ * gives the index of the first zero byte of 'val' in memory order.
+ */
+#include <linux/bitops.h>
+
+struct word_at_a_time {
+	const unsigned long one_bits, high_bits;
+};
+
+#ifndef __ARMEB__
+
+#define WORD_AT_A_TIME_CONSTANTS { 0x01010101UL, 0x80808080UL }
+
+/*
+ * The lowest set bit of the result is exact; bits above the first zero
+ * byte may be false positives, which does not matter on little-endian
+ * where the first byte in memory is the least significant one.
+ */
+static inline unsigned long has_zero(unsigned long a, unsigned long *bits,
+				     const struct word_at_a_time *c)
+{
+	unsigned long mask = ((a - c->one_bits) & ~a) & c->high_bits;
+	*bits = mask;
+	return mask;
+}
+
+#define prep_zero_mask(a, bits, c) (bits)
+
+/* 0xff in every byte before the first zero byte */
+static inline unsigned long create_zero_mask(unsigned long bits)
+{
+	bits = (bits - 1) & ~bits;
+	return bits >> 7;
+}
+
+static inline unsigned long find_zero(unsigned long mask)
+{
+	return fls(mask) >> 3;
+}
+
+/* 0xff in the first 'n' bytes in memory, 0 <= n < sizeof(long) */
+static inline unsigned long leading_bytes_mask(unsigned long n)
+{
+	return (1UL << (8 * n)) - 1;
+}
+
+#else	/* __ARMEB__ */
+
+#define WORD_AT_A_TIME_CONSTANTS { 0x7f7f7f7fUL, 0x80808080UL }
+
+/*
+ * Big-endian needs the exact test: a false positive in a more significant
+ * byte would come before the real zero in memory.
+ */
+static inline unsigned long has_zero(unsigned long a, unsigned long *bits,
+				     const struct word_at_a_time *c)
+{
+	unsigned long mask = ~(((a & c->one_bits) + c->one_bits) |
+			       a | c->one_bits);
+	*bits = mask;
+	return mask;
+}
+
+#define prep_zero_mask(a, bits, c) (bits)
+#define create_zero_mask(bits) (bits)
+
+static inline unsigned long find_zero(unsigned long mask)
+{
+	return (32 - fls(mask)) >> 3;
+}
+
+static inline unsigned long leading_bytes_mask(unsigned long n)
+{
+	return n ? ~0UL << (32 - 8 * n) : 0;
+}
+
+#endif	/* __ARMEB__ */
+
+#endif /* __ASM_ARM_WORD_AT_A_TIME_H */
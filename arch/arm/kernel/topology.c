@@ -0,0 +1,85 @@
+/*
+ *  linux/arch/arm/kernel/topology.c
+ *
+ *  Frequency dependent CPU power for the scheduler.  Each CPU's power
+ *  is scaled by its current frequency over the highest frequency it
+ *  supports, so that with the ARCH_POWER scheduler feature set a CPU
+ *  running at half speed is counted as half a CPU.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/percpu.h>
+#include <linux/cpufreq.h>
+#include <linux/sched.h>
+
+static DEFINE_PER_CPU(unsigned long, cpu_freq_power) = SCHED_POWER_SCALE;
+static DEFINE_PER_CPU(unsigned int, cpu_max_freq);
+
+unsigned long arch_scale_freq_power(struct sched_domain *sd, int cpu)
+{
+	return per_cpu(cpu_freq_power, cpu);
+}
+
+static void set_freq_power(int cpu, unsigned int freq)
+{
+	unsigned int max = per_cpu(cpu_max_freq, cpu);
+	unsigned long power = SCHED_POWER_SCALE;
+
+	if (max && freq < max)
+		power = ((unsigned long long)freq << SCHED_POWER_SHIFT) / max;
+
+	/* Never report a CPU as having no capacity at all */
+	per_cpu(cpu_freq_power, cpu) = max_t(unsigned long, power, 1);
+}
+
+static int freq_power_transition(struct notifier_block *nb,
+				 unsigned long val, void *data)
+{
+	struct cpufreq_freqs *freqs = data;
+
+	if (val == CPUFREQ_POSTCHANGE)
+		set_freq_power(freqs->cpu, freqs->new);
+
+	return NOTIFY_OK;
+}
+
+static int freq_power_policy(struct notifier_block *nb,
+			     unsigned long val, void *data)
+{
+	struct cpufreq_policy *policy = data;
+	int cpu;
+
+	if (val != CPUFREQ_NOTIFY)
+		return NOTIFY_OK;
+
+	for_each_cpu(cpu, policy->cpus) {
+		per_cpu(cpu_max_freq, cpu) = policy->cpuinfo.max_freq;
+		if (policy->cur)
+			set_freq_power(cpu, policy->cur);
+	}
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block freq_power_transition_nb = {
+	.notifier_call	= freq_power_transition,
+};
+
+static struct notifier_block freq_power_policy_nb = {
+	.notifier_call	= freq_power_policy,
+};
+
+static int __init freq_power_init(void)
+{
+	cpufreq_register_notifier(&freq_power_policy_nb,
+				  CPUFREQ_POLICY_NOTIFIER);
+	return cpufreq_register_notifier(&freq_power_transition_nb,
+					 CPUFREQ_TRANSITION_NOTIFIER);
+}
+/* Before the cpufreq drivers register their first policy */
+core_initcall(freq_power_init);
@@ -0,0 +1,126 @@
+/*
+ *  linux/arch/arm/lib/memcpy_neon_glue.c
+ *
+ *  Size class selection for memcpy().  Copies of at least memcpy_neon_min
+ *  bytes are diverted here by memcpy.S and, when made from process context,
+ *  done by the NEON loop in memcpy_neon.S.  Everything else uses the
+ *  ldm/stm template.  The threshold and the NEON prefetch distance are
+ *  chosen at boot from the CPU part number and can be overridden with
+ *  "memcpy_neon=<min bytes>[,<prefetch distance>]" or turned off with
+ *  "memcpy_neon=off".
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/string.h>
+#include <linux/hardirq.h>
+#include <linux/irqflags.h>
+#include <asm/cputype.h>
+#include <asm/neon.h>
+
+extern void *__memcpy_arm(void *dest, const void *src, size_t n);
+extern void *__memcpy_neon(void *dest, const void *src, size_t n,
+			   unsigned int pld_dist);
+
+/*
+ * Below this size the ldm/stm copy is as fast as NEON and avoids the
+ * VFP state save.  It also keeps small structure copies, such as the
+ * thread VFP state itself, off the NEON path.
+ */
+#define MEMCPY_NEON_MIN_FLOOR	512
+
+/* Read by memcpy.S; ~0 keeps every copy on the ldm/stm path. */
+unsigned long memcpy_neon_min = ~0UL;
+static unsigned int memcpy_neon_pld = 256;
+
+static unsigned long memcpy_neon_min_param __initdata;
+static unsigned int memcpy_neon_pld_param __initdata;
+static int memcpy_neon_off __initdata;
+
+struct memcpy_neon_tuning {
+	unsigned int part;
+	unsigned long min;
+	unsigned int pld;
+};
+
+/*
+ * Cortex-A8 has slow ldm/stm and a 64-byte line, so NEON pays off early.
+ * Cortex-A9 streams well with ldm/stm for medium copies; use NEON only
+ * for copies of a page and more, and prefetch further ahead to cover the
+ * DRAM latency of the L2 miss.
+ */
+static const struct memcpy_neon_tuning memcpy_neon_tunings[] __initconst = {
+	{ 0xc08,  512, 192 },	/* Cortex-A8 */
+	{ 0xc09, 4096, 320 },	/* Cortex-A9 */
+	{ 0xc0f, 1024, 256 },	/* Cortex-A15 */
+};
+
+void *memcpy_neon_large(void *dest, const void *src, size_t n)
+{
+	if (in_interrupt() || irqs_disabled())
+		return __memcpy_arm(dest, src, n);
+
+	kernel_neon_begin();
+	__memcpy_neon(dest, src, n, memcpy_neon_pld);
+	kernel_neon_end();
+
+	return dest;
+}
+
+static int __init memcpy_neon_setup(char *str)
+{
+	char *p;
+
+	if (!strcmp(str, "off")) {
+		memcpy_neon_off = 1;
+		return 1;
+	}
+
+	memcpy_neon_min_param = simple_strtoul(str, &p, 0);
+	if (*p == ',')
+		memcpy_neon_pld_param = simple_strtoul(p + 1, NULL, 0);
+
+	return 1;
+}
+__setup("memcpy_neon=", memcpy_neon_setup);
+
+static int __init memcpy_neon_init(void)
+{
+	unsigned int id = read_cpuid_id();
+	unsigned long min = 0;
+	int i;
+
+	if (!cpu_has_neon() || memcpy_neon_off)
+		return 0;
+
+	if ((id >> 24) == 0x41) {
+		for (i = 0; i < ARRAY_SIZE(memcpy_neon_tunings); i++) {
+			if (memcpy_neon_tunings[i].part != ((id >> 4) & 0xfff))
+				continue;
+			min = memcpy_neon_tunings[i].min;
+			memcpy_neon_pld = memcpy_neon_tunings[i].pld;
+			break;
+		}
+	}
+
+	if (memcpy_neon_min_param)
+		min = memcpy_neon_min_param;
+	if (memcpy_neon_pld_param)
+		memcpy_neon_pld = ALIGN(memcpy_neon_pld_param, 32);
+
+	/* Unknown CPU and no override: stay on ldm/stm */
+	if (!min)
+		return 0;
+
+	memcpy_neon_min = max_t(unsigned long, min, MEMCPY_NEON_MIN_FLOOR);
+	pr_info("memcpy: NEON for copies of %lu bytes and more, "
+		"prefetch distance %u\n", memcpy_neon_min, memcpy_neon_pld);
+
+	return 0;
+}
+/* HWCAP_NEON is set by vfp_init(), a late_initcall */
+late_initcall_sync(memcpy_neon_init);
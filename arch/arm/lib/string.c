@@ -0,0 +1,209 @@
+/*
+ *  linux/arch/arm/lib/string.c
+ *
+ *  Word-at-a-time strlen(), strcmp(), strncmp(), strchr(), strrchr() and
+ *  memchr().
+ *
+ *  The strings are read a naturally aligned word at a time.  An aligned
+ *  word never crosses a page boundary, so reading the bytes after the
+ *  terminating NUL of a string, or before its first byte, cannot fault.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/types.h>
+#include <linux/string.h>
+#include <asm/word-at-a-time.h>
+
+#define WORD_MASK	(sizeof(unsigned long) - 1)
+
+size_t strlen(const char *s)
+{
+	const struct word_at_a_time constants = WORD_AT_A_TIME_CONSTANTS;
+	unsigned long align = (unsigned long)s & WORD_MASK;
+	const unsigned long *p = (const unsigned long *)(s - align);
+	unsigned long val, bits;
+
+	/* Bytes before 's' in the first word must not look like a NUL */
+	val = *p | leading_bytes_mask(align);
+	while (!has_zero(val, &bits, &constants))
+		val = *++p;
+
+	bits = prep_zero_mask(val, bits, &constants);
+	return (const char *)p - s + find_zero(create_zero_mask(bits));
+}
+
+int strcmp(const char *cs, const char *ct)
+{
+	const struct word_at_a_time constants = WORD_AT_A_TIME_CONSTANTS;
+	unsigned long a, b, bits;
+	unsigned char c1, c2;
+
+	/* Words can only be compared if both strings share an alignment */
+	if (!(((unsigned long)cs ^ (unsigned long)ct) & WORD_MASK)) {
+		while ((unsigned long)cs & WORD_MASK) {
+			c1 = *cs++;
+			c2 = *ct++;
+			if (c1 != c2)
+				return c1 < c2 ? -1 : 1;
+			if (!c1)
+				return 0;
+		}
+		for (;;) {
+			a = *(const unsigned long *)cs;
+			b = *(const unsigned long *)ct;
+			if (a != b || has_zero(a, &bits, &constants))
+				break;
+			cs += sizeof(unsigned long);
+			ct += sizeof(unsigned long);
+		}
+	}
+
+	/* Find the differing byte or the NUL within the last word */
+	while (1) {
+		c1 = *cs++;
+		c2 = *ct++;
+		if (c1 != c2)
+			return c1 < c2 ? -1 : 1;
+		if (!c1)
+			break;
+	}
+	return 0;
+}
+
+int strncmp(const char *cs, const char *ct, size_t count)
+{
+	const struct word_at_a_time constants = WORD_AT_A_TIME_CONSTANTS;
+	unsigned long a, b, bits;
+	unsigned char c1, c2;
+
+	if (!(((unsigned long)cs ^ (unsigned long)ct) & WORD_MASK)) {
+		while (count && ((unsigned long)cs & WORD_MASK)) {
+			c1 = *cs++;
+			c2 = *ct++;
+			if (c1 != c2)
+				return c1 < c2 ? -1 : 1;
+			if (!c1)
+				return 0;
+			count--;
+		}
+		while (count >= sizeof(unsigned long)) {
+			a = *(const unsigned long *)cs;
+			b = *(const unsigned long *)ct;
+			if (a != b || has_zero(a, &bits, &constants))
+				break;
+			cs += sizeof(unsigned long);
+			ct += sizeof(unsigned long);
+			count -= sizeof(unsigned long);
+		}
+	}
+
+	while (count) {
+		c1 = *cs++;
+		c2 = *ct++;
+		if (c1 != c2)
+			return c1 < c2 ? -1 : 1;
+		if (!c1)
+			break;
+		count--;
+	}
+	return 0;
+}
+
+char *strchr(const char *s, int c)
+{
+	const struct word_at_a_time constants = WORD_AT_A_TIME_CONSTANTS;
+	unsigned long align = (unsigned long)s & WORD_MASK;
+	const unsigned long *p = (const unsigned long *)(s - align);
+	unsigned long lead = leading_bytes_mask(align);
+	unsigned long pattern, val, nul, match, bits;
+	const unsigned char *q;
+
+	/* A byte equal to 'c' becomes a zero byte after the xor */
+	pattern = (unsigned char)c * 0x01010101UL;
+	for (;; p++, lead = 0) {
+		val = *p;
+		has_zero(val | lead, &nul, &constants);
+		has_zero((val ^ pattern) | lead, &match, &constants);
+		if (nul | match)
+			break;
+	}
+
+	/* The first byte that is either the NUL or 'c' */
+	bits = prep_zero_mask(val, nul | match, &constants);
+	q = (const unsigned char *)p + find_zero(create_zero_mask(bits));
+	return *q == (unsigned char)c ? (char *)q : NULL;
+}
+
+char *strrchr(const char *s, int c)
+{
+	const struct word_at_a_time constants = WORD_AT_A_TIME_CONSTANTS;
+	unsigned long align = (unsigned long)s & WORD_MASK;
+	const unsigned long *p = (const unsigned long *)(s - align);
+	const unsigned long *hit = NULL;
+	unsigned long lead = leading_bytes_mask(align);
+	unsigned long pattern, val, bits;
+	const unsigned char *q, *last = NULL;
+
+	/* Remember the last whole word before the NUL that holds a 'c' */
+	pattern = (unsigned char)c * 0x01010101UL;
+	for (;; p++, lead = 0) {
+		val = *p;
+		if (has_zero(val | lead, &bits, &constants))
+			break;
+		if (has_zero((val ^ pattern) | lead, &bits, &constants))
+			hit = p;
+	}
+
+	/* The word with the NUL, which may hold the last 'c' itself */
+	q = (const unsigned char *)p;
+	if (q < (const unsigned char *)s)
+		q = (const unsigned char *)s;
+	for (;; q++) {
+		if (*q == (unsigned char)c)
+			last = q;
+		if (!*q)
+			break;
+	}
+	if (last || !hit)
+		return (char *)last;
+
+	/* Otherwise the last 'c' of that word, which lies within 's' */
+	for (q = (const unsigned char *)(hit + 1) - 1;
+	     *q != (unsigned char)c; q--)
+		;
+	return (char *)q;
+}
+
+void *memchr(const void *s, int c, size_t n)
+{
+	const struct word_at_a_time constants = WORD_AT_A_TIME_CONSTANTS;
+	const unsigned char *p = s;
+	const unsigned long *w;
+	unsigned long pattern, val, bits;
+
+	while (n && ((unsigned long)p & WORD_MASK)) {
+		if (*p == (unsigned char)c)
+			return (void *)p;
+		p++;
+		n--;
+	}
+
+	/* A matching byte becomes a zero byte after the xor */
+	pattern = (unsigned char)c * 0x01010101UL;
+	for (w = (const unsigned long *)p; n >= sizeof(unsigned long); w++) {
+		val = *w ^ pattern;
+		if (has_zero(val, &bits, &constants)) {
+			bits = prep_zero_mask(val, bits, &constants);
+			return (void *)w + find_zero(create_zero_mask(bits));
+		}
+		n -= sizeof(unsigned long);
+	}
+
+	for (p = (const unsigned char *)w; n; p++, n--)
+		if (*p == (unsigned char)c)
+			return (void *)p;
+	return NULL;
+}
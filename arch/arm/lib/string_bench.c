@@ -0,0 +1,164 @@
+/*
+ *  linux/arch/arm/lib/string_bench.c
+ *
+ *  Times the word-at-a-time string functions against the byte-at-a-time
+ *  versions from lib/string.c.  Results are printed when the module is
+ *  loaded, in nanoseconds per call, e.g.
+ *
+ *	string_bench: strlen   len   64: arm    21 ns  generic    83 ns
+ *
+ *  The module always fails to load, so it can be run again with insmod.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/moduleparam.h>
+#include <linux/string.h>
+#include <linux/slab.h>
+#include <linux/ktime.h>
+#include <linux/sched.h>
+#include <asm/div64.h>
+
+#include "string_generic.h"
+
+static unsigned int iterations = 10000;
+module_param(iterations, uint, 0444);
+MODULE_PARM_DESC(iterations, "calls per function and length");
+
+static unsigned int misalign = 1;
+module_param(misalign, uint, 0444);
+MODULE_PARM_DESC(misalign, "offset of the strings from a word boundary");
+
+static const unsigned int bench_lens[] = { 4, 8, 16, 32, 64, 256, 1024, 4096 };
+
+#define MAX_LEN		4096
+
+enum {
+	BENCH_STRLEN, BENCH_STRCMP, BENCH_STRNCMP, BENCH_MEMCHR,
+	BENCH_STRCHR, BENCH_STRRCHR,
+};
+
+static const char * const bench_names[] = {
+	"strlen", "strcmp", "strncmp", "memchr", "strchr", "strrchr",
+};
+
+struct string_ops {
+	size_t (*strlen)(const char *);
+	int (*strcmp)(const char *, const char *);
+	int (*strncmp)(const char *, const char *, size_t);
+	void *(*memchr)(const void *, int, size_t);
+	char *(*strchr)(const char *, int);
+	char *(*strrchr)(const char *, int);
+};
+
+static const struct string_ops arm_ops = {
+	.strlen		= strlen,
+	.strcmp		= strcmp,
+	.strncmp	= strncmp,
+	.memchr		= memchr,
+	.strchr		= strchr,
+	.strrchr	= strrchr,
+};
+
+static const struct string_ops generic_ops = {
+	.strlen		= generic_strlen,
+	.strcmp		= generic_strcmp,
+	.strncmp	= generic_strncmp,
+	.memchr		= generic_memchr,
+	.strchr		= generic_strchr,
+	.strrchr	= generic_strrchr,
+};
+
+static u64 bench_one(const struct string_ops *ops, int test,
+		     const char *a, const char *b, unsigned int len)
+{
+	unsigned long sink = 0;
+	ktime_t start;
+	unsigned int i;
+
+	start = ktime_get();
+	for (i = 0; i < iterations; i++) {
+		switch (test) {
+		case BENCH_STRLEN:
+			sink += ops->strlen(a);
+			break;
+		case BENCH_STRCMP:
+			sink += ops->strcmp(a, b);
+			break;
+		case BENCH_STRNCMP:
+			sink += ops->strncmp(a, b, len);
+			break;
+		case BENCH_MEMCHR:
+			/* The NUL is the only match, at the very end */
+			sink += (unsigned long)ops->memchr(a, 0, len + 1);
+			break;
+		case BENCH_STRCHR:
+			/* No match, so the whole string is scanned */
+			sink += (unsigned long)ops->strchr(a, 'Z');
+			break;
+		case BENCH_STRRCHR:
+			sink += (unsigned long)ops->strrchr(a, 'Z');
+			break;
+		}
+	}
+	/* Keep the calls from being optimised away */
+	asm volatile("" : : "r" (sink));
+
+	return ktime_to_ns(ktime_sub(ktime_get(), start));
+}
+
+static int __init string_bench_init(void)
+{
+	char *buf_a, *buf_b, *a, *b;
+	unsigned int i, len;
+	u64 t_arm, t_gen;
+	int test;
+
+	buf_a = kmalloc(MAX_LEN + 8, GFP_KERNEL);
+	buf_b = kmalloc(MAX_LEN + 8, GFP_KERNEL);
+	if (!buf_a || !buf_b)
+		goto out;
+
+	a = buf_a + (misalign & 7);
+	b = buf_b + (misalign & 7);
+	for (i = 0; i < MAX_LEN; i++)
+		a[i] = b[i] = 'a' + i % 26;
+
+	if (!iterations)
+		iterations = 1;
+
+	for (test = BENCH_STRLEN; test <= BENCH_STRRCHR; test++) {
+		for (i = 0; i < ARRAY_SIZE(bench_lens); i++) {
+			len = bench_lens[i];
+			a[len] = b[len] = '\0';
+
+			t_arm = bench_one(&arm_ops, test, a, b, len);
+			t_gen = bench_one(&generic_ops, test, a, b, len);
+
+			a[len] = b[len] = 'a' + len % 26;
+
+			do_div(t_arm, iterations);
+			do_div(t_gen, iterations);
+			printk(KERN_INFO "string_bench: %-8s len %4u: "
+			       "arm %5llu ns  generic %5llu ns\n",
+			       bench_names[test], len,
+			       (unsigned long long)t_arm,
+			       (unsigned long long)t_gen);
+			cond_resched();
+		}
+	}
+
+out:
+	kfree(buf_a);
+	kfree(buf_b);
+	return -EAGAIN;
+}
+
+module_init(string_bench_init);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Benchmark of the ARM string functions");
@@ -0,0 +1,81 @@
+/*
+ *  linux/arch/arm/lib/string_generic.h
+ *
+ *  Byte-at-a-time string functions as found in lib/string.c, used as the
+ *  reference by the string self-test and benchmark.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+static noinline size_t generic_strlen(const char *s)
+{
+	const char *sc;
+
+	for (sc = s; *sc != '\0'; ++sc)
+		/* nothing */;
+	return sc - s;
+}
+
+static noinline int generic_strcmp(const char *cs, const char *ct)
+{
+	unsigned char c1, c2;
+
+	while (1) {
+		c1 = *cs++;
+		c2 = *ct++;
+		if (c1 != c2)
+			return c1 < c2 ? -1 : 1;
+		if (!c1)
+			break;
+	}
+	return 0;
+}
+
+static noinline int generic_strncmp(const char *cs, const char *ct,
+				    size_t count)
+{
+	unsigned char c1, c2;
+
+	while (count) {
+		c1 = *cs++;
+		c2 = *ct++;
+		if (c1 != c2)
+			return c1 < c2 ? -1 : 1;
+		if (!c1)
+			break;
+		count--;
+	}
+	return 0;
+}
+
+static noinline char *generic_strchr(const char *s, int c)
+{
+	for (; *s != (char)c; ++s)
+		if (*s == '\0')
+			return NULL;
+	return (char *)s;
+}
+
+static noinline char *generic_strrchr(const char *s, int c)
+{
+	const char *p = s + generic_strlen(s);
+
+	do {
+		if (*p == (char)c)
+			return (char *)p;
+	} while (--p >= s);
+	return NULL;
+}
+
+static noinline void *generic_memchr(const void *s, int c, size_t n)
+{
+	const unsigned char *p = s;
+
+	while (n-- != 0) {
+		if ((unsigned char)c == *p++)
+			return (void *)(p - 1);
+	}
+	return NULL;
+}
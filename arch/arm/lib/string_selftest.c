@@ -0,0 +1,109 @@
+/*
+ *  linux/arch/arm/lib/string_selftest.c
+ *
+ *  Boot-time check of the word-at-a-time string functions against the
+ *  byte-at-a-time ones, for every source alignment and for strings ending
+ *  at every position within a word.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/errno.h>
+
+#include "string_generic.h"
+
+#define TEST_LEN	48
+
+static char buf_a[TEST_LEN + 16] __initdata __aligned(8);
+static char buf_b[TEST_LEN + 16] __initdata __aligned(8);
+
+static int __init sign(int x)
+{
+	return (x > 0) - (x < 0);
+}
+
+/*
+ * Put the same string of 'len' bytes at 'a' and 'b', with bytes above 0x7f
+ * to catch signed comparisons.  The rest of the buffers is zeroed, so
+ * bytes read before the start of a string look like a terminator.
+ */
+static void __init fill(char *a, char *b, int len)
+{
+	int i;
+
+	memset(buf_a, 0, sizeof(buf_a));
+	memset(buf_b, 0, sizeof(buf_b));
+	for (i = 0; i < len; i++)
+		a[i] = b[i] = 0x20 + (i * 37) % 0x5f + (i & 1 ? 0x80 : 0);
+	a[len] = b[len] = '\0';
+}
+
+static int __init test_string(void)
+{
+	int oa, ob, len, i, n;
+	int errors = 0;
+	char *a, *b;
+
+	for (oa = 0; oa < 8; oa++)
+	for (ob = 0; ob < 8; ob++)
+	for (len = 0; len < TEST_LEN; len++) {
+		a = buf_a + oa;
+		b = buf_b + ob;
+
+		fill(a, b, len);
+		if (strlen(a) != generic_strlen(a))
+			errors++;
+		if (strcmp(a, b) || strncmp(a, b, len + 8))
+			errors++;
+
+		/* A difference, or an early end, at every position */
+		for (i = 0; i < len; i++) {
+			b[i] ^= 0x80;
+			if (sign(strcmp(a, b)) !=
+			    sign(generic_strcmp(a, b)))
+				errors++;
+			for (n = i - 1; n <= i + 1; n++)
+				if (n >= 0 && sign(strncmp(a, b, n)) !=
+				    sign(generic_strncmp(a, b, n)))
+					errors++;
+			b[i] ^= 0x80;
+		}
+		b[len] = 'x';
+		b[len + 1] = '\0';
+		if (sign(strcmp(a, b)) != sign(generic_strcmp(a, b)) ||
+		    sign(strcmp(b, a)) != sign(generic_strcmp(b, a)))
+			errors++;
+
+		/* memchr() for every byte, the NUL and a missing byte */
+		for (i = 0; i <= len; i++)
+			for (n = 0; n <= len + 1; n++)
+				if (memchr(a, a[i], n) !=
+				    generic_memchr(a, a[i], n))
+					errors++;
+		if (memchr(a, 0x01, len) != NULL)
+			errors++;
+
+		/* strchr() and strrchr() likewise */
+		for (i = 0; i <= len; i++)
+			if (strchr(a, a[i]) != generic_strchr(a, a[i]) ||
+			    strrchr(a, a[i]) != generic_strrchr(a, a[i]))
+				errors++;
+		if (strchr(a, 0x01) != NULL || strrchr(a, 0x01) != NULL)
+			errors++;
+	}
+
+	if (errors) {
+		WARN(1, "string self-test: %d errors\n", errors);
+		return -EINVAL;
+	}
+
+	printk(KERN_INFO "string self-test passed\n");
+	return 0;
+}
+
+late_initcall(test_string);
@@ -17,11 +17,13 @@
 #include <linux/sched.h>
 #include <linux/smp.h>
 #include <linux/init.h>
+#include <linux/hardirq.h>
 
 #include <asm/cputype.h>
 #include <asm/thread_notify.h>
 #include <asm/vfp.h>
 #include <asm/cpu_pm.h>
+#include <asm/neon.h>
 
 #include "vfpinstr.h"
 #include "vfp.h"
@@ -42,6 +44,20 @@ void (*vfp_vector)(void) = vfp_null_entry;
  */
 union vfp_state *vfp_current_hw_state[NR_CPUS];
 
+/*
+ * Is 'thread's most up to date state stored in this CPUs hardware?
+ * Must be called from non-preemptible context.
+ */
+static inline bool vfp_state_in_hw(unsigned int cpu,
+				   struct thread_info *thread)
+{
+#ifdef CONFIG_SMP
+	if (thread->vfpstate.hard.cpu != cpu)
+		return false;
+#endif
+	return vfp_current_hw_state[cpu] == &thread->vfpstate;
+}
+
 /*
  * Dual-use variable.
  * Used in startup: set to non-zero if VFP checks fail
@@ -544,6 +560,56 @@ void vfp_flush_hwstate(struct thread_info *thread)
 	put_cpu();
 }
 
+#ifdef CONFIG_KERNEL_MODE_NEON
+
+/*
+ * Kernel-side NEON support functions
+ */
+void kernel_neon_begin(void)
+{
+	unsigned int cpu;
+	u32 fpexc;
+
+	/*
+	 * Kernel mode NEON is only allowed outside of interrupt context
+	 * with preemption disabled.  This makes sure that the kernel mode
+	 * NEON register contents never need to be preserved.
+	 */
+	BUG_ON(in_interrupt());
+	cpu = get_cpu();
+
+	fpexc = fmrx(FPEXC) | FPEXC_EN;
+	fmxr(FPEXC, fpexc);
+
+	/*
+	 * Save the userland NEON/VFP state and force it to be reloaded on the
+	 * next VFP instruction.  On SMP the switch notifier has already saved
+	 * any other thread's state, and vfp_current_hw_state[] may still point
+	 * at a thread that has since migrated and used VFP elsewhere, so only
+	 * 'current' is saved, and only if its live state is in this CPU.  On
+	 * UP the owner can be a thread other than 'current'.
+	 */
+#ifdef CONFIG_SMP
+	if (vfp_state_in_hw(cpu, current_thread_info()))
+		vfp_save_state(&current_thread_info()->vfpstate, fpexc);
+#else
+	if (vfp_current_hw_state[cpu])
+		vfp_save_state(vfp_current_hw_state[cpu], fpexc);
+#endif
+	vfp_current_hw_state[cpu] = NULL;
+}
+EXPORT_SYMBOL(kernel_neon_begin);
+
+void kernel_neon_end(void)
+{
+	/* Disable the NEON/VFP unit. */
+	fmxr(FPEXC, fmrx(FPEXC) & ~FPEXC_EN);
+	put_cpu();
+}
+EXPORT_SYMBOL(kernel_neon_end);
+
+#endif /* CONFIG_KERNEL_MODE_NEON */
+
 /*
  * VFP hardware can lose all context when a CPU goes offline.
  * As we will be running in SMP mode with CPU hotplug, we will save the
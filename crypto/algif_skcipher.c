@@ -15,6 +15,7 @@
 #include <crypto/scatterwalk.h>
 #include <crypto/skcipher.h>
 #include <crypto/if_alg.h>
+#include <linux/aio.h>
 #include <linux/init.h>
 #include <linux/list.h>
 #include <linux/kernel.h>
@@ -40,6 +41,7 @@ struct skcipher_ctx {
 	struct af_alg_completion completion;
 
 	unsigned used;
+	atomic_t inflight;
 
 	unsigned int len;
 	bool more;
@@ -49,9 +51,33 @@ struct skcipher_ctx {
 	struct ablkcipher_request req;
 };
 
+/*
+ * An AIO read is completed out of band.  It owns references to its source
+ * pages, a copy of the IV and the mapping of the destination buffer, so
+ * the socket can take the next request while it is in flight.
+ */
+struct skcipher_async_req {
+	struct kiocb *iocb;
+	struct sock *sk;
+	unsigned int alloc_len;
+
+	struct af_alg_sgl rsgl;
+	struct scatterlist *tsg;
+	unsigned int tsg_nents;
+	unsigned int len;
+
+	u8 *iv;
+
+	/* Must be last, it is followed by the request context */
+	struct ablkcipher_request req;
+};
+
 #define MAX_SGL_ENTS ((PAGE_SIZE - sizeof(struct skcipher_sg_list)) / \
 		      sizeof(struct scatterlist) - 1)
 
+/* AIO reads a socket may have in flight; each also pins its pages */
+#define MAX_ASYNC_REQS 64
+
 static inline int skcipher_sndbuf(struct sock *sk)
 {
 	struct alg_sock *ask = alg_sk(sk);
@@ -415,7 +441,192 @@ unlock:
 	return err ?: size;
 }
 
-static int skcipher_recvmsg(struct kiocb *unused, struct socket *sock,
+/* Number of source scatterlist entries holding the next 'used' bytes */
+static unsigned int skcipher_count_tsgl(struct skcipher_ctx *ctx, int used)
+{
+	struct skcipher_sg_list *sgl;
+	unsigned int nents = 0;
+	int i;
+
+	list_for_each_entry(sgl, &ctx->tsgl, list) {
+		for (i = 0; i < sgl->cur && used > 0; i++) {
+			if (!sg_page(sgl->sg + i))
+				continue;
+			used -= sgl->sg[i].length;
+			nents++;
+		}
+	}
+
+	return nents;
+}
+
+/* Take references to the source pages of the next 'used' bytes */
+static unsigned int skcipher_grab_tsgl(struct skcipher_ctx *ctx,
+				       struct scatterlist *tsg, int used)
+{
+	struct skcipher_sg_list *sgl;
+	struct scatterlist *sg;
+	unsigned int nents = 0;
+	int i, plen;
+
+	list_for_each_entry(sgl, &ctx->tsgl, list) {
+		for (i = 0; i < sgl->cur && used > 0; i++) {
+			sg = sgl->sg + i;
+			if (!sg_page(sg))
+				continue;
+
+			plen = min_t(int, used, sg->length);
+			get_page(sg_page(sg));
+			sg_set_page(tsg + nents++, sg_page(sg), plen,
+				    sg->offset);
+			used -= plen;
+		}
+	}
+
+	if (nents)
+		sg_mark_end(tsg + nents - 1);
+
+	return nents;
+}
+
+static void skcipher_free_async_req(struct skcipher_async_req *sreq)
+{
+	struct sock *sk = sreq->sk;
+	struct skcipher_ctx *ctx = alg_sk(sk)->private;
+	unsigned int i;
+
+	af_alg_free_sg(&sreq->rsgl);
+	for (i = 0; i < sreq->tsg_nents; i++)
+		put_page(sg_page(sreq->tsg + i));
+
+	sock_kfree_s(sk, sreq, sreq->alloc_len);
+	atomic_dec(&ctx->inflight);
+}
+
+static void skcipher_async_complete(struct crypto_async_request *req, int err)
+{
+	struct skcipher_async_req *sreq = req->data;
+	struct kiocb *iocb = sreq->iocb;
+	struct sock *sk = sreq->sk;
+	long res = err ?: sreq->len;
+
+	if (err == -EINPROGRESS)
+		return;
+
+	skcipher_free_async_req(sreq);
+	aio_complete(iocb, res, 0);
+
+	/* Drops the reference taken when the request was queued */
+	sock_put(sk);
+}
+
+/*
+ * Queue the data sent so far for an AIO read.  The whole request, up to
+ * ALG_MAX_PAGES pages of the first iovec, becomes one cipher request
+ * using the IV from the last sendmsg(), and the read completes when the
+ * cipher does.  Userspace can keep up to MAX_ASYNC_REQS of these in
+ * flight, which keeps an async cipher, e.g. one wrapped by cryptd or
+ * pcrypt, busy on every CPU.  The requests are charged to the socket's
+ * option memory, so optmem_max bounds them too.
+ */
+static int skcipher_recvmsg_async(struct kiocb *iocb, struct socket *sock,
+				  struct msghdr *msg, int flags)
+{
+	struct sock *sk = sock->sk;
+	struct alg_sock *ask = alg_sk(sk);
+	struct skcipher_ctx *ctx = ask->private;
+	struct crypto_ablkcipher *tfm = crypto_ablkcipher_reqtfm(&ctx->req);
+	unsigned bs = crypto_ablkcipher_blocksize(tfm);
+	unsigned ivsize = crypto_ablkcipher_ivsize(tfm);
+	unsigned int reqsize = crypto_ablkcipher_reqsize(tfm);
+	struct skcipher_async_req *sreq;
+	unsigned int nents, len, alloc_len;
+	int used;
+	int err;
+
+	if (!msg->msg_iovlen)
+		return 0;
+
+	lock_sock(sk);
+	if (!ctx->used) {
+		err = skcipher_wait_for_data(sk, flags);
+		if (err)
+			goto unlock;
+	}
+
+	err = -EAGAIN;
+	if (atomic_read(&ctx->inflight) >= MAX_ASYNC_REQS)
+		goto unlock;
+
+	used = min_t(unsigned long, ctx->used, msg->msg_iov->iov_len);
+	nents = skcipher_count_tsgl(ctx, used);
+
+	len = ALIGN(sizeof(*sreq) + reqsize, __alignof__(struct scatterlist));
+	alloc_len = len + nents * sizeof(struct scatterlist) + ivsize;
+	err = -ENOMEM;
+	sreq = sock_kmalloc(sk, alloc_len, GFP_KERNEL);
+	if (!sreq)
+		goto unlock;
+
+	memset(sreq, 0, alloc_len);
+	sreq->tsg = (void *)sreq + len;
+	sreq->iv = (u8 *)(sreq->tsg + nents);
+	sreq->iocb = iocb;
+	sreq->sk = sk;
+	sreq->alloc_len = alloc_len;
+	atomic_inc(&ctx->inflight);
+
+	used = af_alg_make_sg(&sreq->rsgl, msg->msg_iov->iov_base, used, 1);
+	err = used;
+	if (err < 0) {
+		sock_kfree_s(sk, sreq, alloc_len);
+		atomic_dec(&ctx->inflight);
+		goto unlock;
+	}
+
+	if (ctx->more || used < ctx->used)
+		used -= used % bs;
+
+	err = -EINVAL;
+	if (!used)
+		goto free;
+
+	sreq->tsg_nents = skcipher_grab_tsgl(ctx, sreq->tsg, used);
+	sreq->len = used;
+	memcpy(sreq->iv, ctx->iv, ivsize);
+
+	ablkcipher_request_set_tfm(&sreq->req, tfm);
+	ablkcipher_request_set_callback(&sreq->req, CRYPTO_TFM_REQ_MAY_BACKLOG,
+					skcipher_async_complete, sreq);
+	ablkcipher_request_set_crypt(&sreq->req, sreq->tsg, sreq->rsgl.sg,
+				     used, sreq->iv);
+
+	skcipher_pull_sgl(sk, used);
+
+	sock_hold(sk);
+	err = ctx->enc ? crypto_ablkcipher_encrypt(&sreq->req) :
+			 crypto_ablkcipher_decrypt(&sreq->req);
+	if (err == -EINPROGRESS || err == -EBUSY) {
+		err = -EIOCBQUEUED;
+		goto unlock;
+	}
+
+	/* Completed synchronously, the caller completes the iocb */
+	sock_put(sk);
+	if (!err)
+		err = used;
+
+free:
+	skcipher_free_async_req(sreq);
+
+unlock:
+	skcipher_wmem_wakeup(sk);
+	release_sock(sk);
+
+	return err;
+}
+
+static int skcipher_recvmsg(struct kiocb *iocb, struct socket *sock,
 			    struct msghdr *msg, size_t ignored, int flags)
 {
 	struct sock *sk = sock->sk;
@@ -431,6 +642,9 @@ static int skcipher_recvmsg(struct kiocb *unused, struct socket *sock,
 	int used;
 	long copied = 0;
 
+	if (!is_sync_kiocb(iocb))
+		return skcipher_recvmsg_async(iocb, sock, msg, flags);
+
 	lock_sock(sk);
 	for (iov = msg->msg_iov, iovlen = msg->msg_iovlen; iovlen > 0;
 	     iovlen--, iov++) {
@@ -590,6 +804,7 @@ static int skcipher_accept_parent(void *private, struct sock *sk)
 	INIT_LIST_HEAD(&ctx->tsgl);
 	ctx->len = len;
 	ctx->used = 0;
+	atomic_set(&ctx->inflight, 0);
 	ctx->more = 0;
 	ctx->merge = 0;
 	ctx->enc = 0;
@@ -20,6 +20,7 @@
 
 #include <crypto/algapi.h>
 #include <crypto/internal/aead.h>
+#include <crypto/internal/skcipher.h>
 #include <linux/err.h>
 #include <linux/init.h>
 #include <linux/module.h>
@@ -27,6 +28,7 @@
 #include <linux/notifier.h>
 #include <linux/kobject.h>
 #include <linux/cpu.h>
+#include <linux/workqueue.h>
 #include <crypto/pcrypt.h>
 
 struct padata_pcrypt {
@@ -53,6 +55,16 @@ struct padata_pcrypt {
 		cpumask_var_t mask;
 	} *cb_cpumask;
 	struct notifier_block nblock;
+
+	/*
+	 * Block cipher requests with CRYPTO_TFM_REQ_MAY_BACKLOG that padata
+	 * had no room for, in submission order.  They are handed to padata
+	 * as objects complete, or from backlog_work if completions raced
+	 * with the backlogging.
+	 */
+	spinlock_t backlog_lock;
+	struct list_head backlog;
+	struct delayed_work backlog_work;
 };
 
 static struct padata_pcrypt pencrypt;
@@ -69,6 +81,11 @@ struct pcrypt_aead_ctx {
 	unsigned int cb_cpu;
 };
 
+struct pcrypt_ablkcipher_ctx {
+	struct crypto_ablkcipher *child;
+	unsigned int cb_cpu;
+};
+
 static int pcrypt_do_parallel(struct padata_priv *padata, unsigned int *cb_cpu,
 			      struct padata_pcrypt *pcrypt)
 {
@@ -270,21 +287,216 @@ static int pcrypt_aead_givencrypt(struct aead_givcrypt_request *req)
 	return err;
 }
 
-static int pcrypt_aead_init_tfm(struct crypto_tfm *tfm)
+static int pcrypt_ablkcipher_setkey(struct crypto_ablkcipher *parent,
+				    const u8 *key, unsigned int keylen)
 {
-	int cpu, cpu_index;
-	struct crypto_instance *inst = crypto_tfm_alg_instance(tfm);
-	struct pcrypt_instance_ctx *ictx = crypto_instance_ctx(inst);
-	struct pcrypt_aead_ctx *ctx = crypto_tfm_ctx(tfm);
-	struct crypto_aead *cipher;
+	struct pcrypt_ablkcipher_ctx *ctx = crypto_ablkcipher_ctx(parent);
+	struct crypto_ablkcipher *child = ctx->child;
+	int err;
+
+	crypto_ablkcipher_clear_flags(child, CRYPTO_TFM_REQ_MASK);
+	crypto_ablkcipher_set_flags(child, crypto_ablkcipher_get_flags(parent) &
+					   CRYPTO_TFM_REQ_MASK);
+	err = crypto_ablkcipher_setkey(child, key, keylen);
+	crypto_ablkcipher_set_flags(parent, crypto_ablkcipher_get_flags(child) &
+					    CRYPTO_TFM_RES_MASK);
+
+	return err;
+}
+
+static void pcrypt_ablkcipher_enc(struct padata_priv *padata);
+
+/*
+ * Move backlogged requests to padata for as long as it takes them, and
+ * tell their owners with -EINPROGRESS.  If padata is still full while no
+ * completion of ours may be left to call us again, retry a tick later.
+ */
+static void pcrypt_backlog_run(struct padata_pcrypt *pcrypt)
+{
+	struct ablkcipher_request *req;
+	struct pcrypt_ablkcipher_ctx *ctx;
+	struct pcrypt_request *preq;
+	int err;
+
+	for (;;) {
+		spin_lock_bh(&pcrypt->backlog_lock);
+		if (list_empty(&pcrypt->backlog)) {
+			spin_unlock_bh(&pcrypt->backlog_lock);
+			return;
+		}
+		req = list_first_entry(&pcrypt->backlog,
+				       struct ablkcipher_request, base.list);
+		ctx = crypto_ablkcipher_ctx(crypto_ablkcipher_reqtfm(req));
+		preq = ablkcipher_request_ctx(req);
+		err = pcrypt_do_parallel(pcrypt_request_padata(preq),
+					 &ctx->cb_cpu, pcrypt);
+		if (err == -EBUSY) {
+			schedule_delayed_work(&pcrypt->backlog_work, 1);
+			spin_unlock_bh(&pcrypt->backlog_lock);
+			return;
+		}
+		list_del(&req->base.list);
+		spin_unlock_bh(&pcrypt->backlog_lock);
+
+		local_bh_disable();
+		ablkcipher_request_complete(req, err ? err : -EINPROGRESS);
+		local_bh_enable();
+	}
+}
+
+static void pcrypt_backlog_work(struct work_struct *work)
+{
+	struct padata_pcrypt *pcrypt =
+		container_of(work, struct padata_pcrypt, backlog_work.work);
+
+	pcrypt_backlog_run(pcrypt);
+}
+
+static void pcrypt_ablkcipher_serial(struct padata_priv *padata)
+{
+	struct pcrypt_request *preq = pcrypt_padata_request(padata);
+	struct ablkcipher_request *req = pcrypt_request_ctx(preq);
+	struct padata_pcrypt *pcrypt;
+
+	pcrypt = padata->parallel == pcrypt_ablkcipher_enc ?
+		 &pencrypt : &pdecrypt;
+
+	ablkcipher_request_complete(req->base.data, padata->info);
+
+	if (!list_empty(&pcrypt->backlog))
+		pcrypt_backlog_run(pcrypt);
+}
+
+static void pcrypt_ablkcipher_done(struct crypto_async_request *areq, int err)
+{
+	struct ablkcipher_request *req = areq->data;
+	struct pcrypt_request *preq = ablkcipher_request_ctx(req);
+	struct padata_priv *padata = pcrypt_request_padata(preq);
+
+	if (err == -EINPROGRESS)
+		return;
+
+	padata->info = err;
+	req->base.flags &= ~CRYPTO_TFM_REQ_MAY_SLEEP;
+
+	padata_do_serial(padata);
+}
+
+static void pcrypt_ablkcipher_enc(struct padata_priv *padata)
+{
+	struct pcrypt_request *preq = pcrypt_padata_request(padata);
+	struct ablkcipher_request *req = pcrypt_request_ctx(preq);
+
+	padata->info = crypto_ablkcipher_encrypt(req);
+
+	if (padata->info == -EINPROGRESS)
+		return;
+
+	padata_do_serial(padata);
+}
+
+static void pcrypt_ablkcipher_dec(struct padata_priv *padata)
+{
+	struct pcrypt_request *preq = pcrypt_padata_request(padata);
+	struct ablkcipher_request *req = pcrypt_request_ctx(preq);
+
+	padata->info = crypto_ablkcipher_decrypt(req);
+
+	if (padata->info == -EINPROGRESS)
+		return;
+
+	padata_do_serial(padata);
+}
+
+/*
+ * padata refuses new objects with -EBUSY while too many are in flight.
+ * Block encryption users such as dm-crypt set CRYPTO_TFM_REQ_MAY_BACKLOG
+ * and take -EBUSY to mean that the request was queued and will complete
+ * later, so such requests are put on the backlog.  Without the flag,
+ * -EBUSY means the request was dropped, as for any other crypto queue.
+ *
+ * The child gets neither MAY_SLEEP nor MAY_BACKLOG: it is called from
+ * padata's workers, and a request it backlogged would be completed twice.
+ */
+static int pcrypt_ablkcipher_crypt(struct ablkcipher_request *req,
+				   struct padata_pcrypt *pcrypt,
+				   void (*parallel)(struct padata_priv *padata))
+{
+	int err;
+	struct pcrypt_request *preq = ablkcipher_request_ctx(req);
+	struct ablkcipher_request *creq = pcrypt_request_ctx(preq);
+	struct padata_priv *padata = pcrypt_request_padata(preq);
+	struct crypto_ablkcipher *tfm = crypto_ablkcipher_reqtfm(req);
+	struct pcrypt_ablkcipher_ctx *ctx = crypto_ablkcipher_ctx(tfm);
+	u32 flags = ablkcipher_request_flags(req);
+
+	memset(padata, 0, sizeof(struct padata_priv));
+
+	padata->parallel = parallel;
+	padata->serial = pcrypt_ablkcipher_serial;
+
+	ablkcipher_request_set_tfm(creq, ctx->child);
+	ablkcipher_request_set_callback(creq, flags &
+					~(CRYPTO_TFM_REQ_MAY_SLEEP |
+					  CRYPTO_TFM_REQ_MAY_BACKLOG),
+					pcrypt_ablkcipher_done, req);
+	ablkcipher_request_set_crypt(creq, req->src, req->dst,
+				     req->nbytes, req->info);
+
+	spin_lock_bh(&pcrypt->backlog_lock);
+	/* Don't overtake requests that are already backlogged */
+	if (list_empty(&pcrypt->backlog))
+		err = pcrypt_do_parallel(padata, &ctx->cb_cpu, pcrypt);
+	else
+		err = -EBUSY;
+	if (err == -EBUSY && (flags & CRYPTO_TFM_REQ_MAY_BACKLOG)) {
+		list_add_tail(&req->base.list, &pcrypt->backlog);
+		/* All objects in flight may have passed their backlog check */
+		schedule_delayed_work(&pcrypt->backlog_work, 1);
+	}
+	spin_unlock_bh(&pcrypt->backlog_lock);
+
+	if (!err)
+		return -EINPROGRESS;
+
+	return err;
+}
+
+static int pcrypt_ablkcipher_encrypt(struct ablkcipher_request *req)
+{
+	return pcrypt_ablkcipher_crypt(req, &pencrypt, pcrypt_ablkcipher_enc);
+}
+
+static int pcrypt_ablkcipher_decrypt(struct ablkcipher_request *req)
+{
+	return pcrypt_ablkcipher_crypt(req, &pdecrypt, pcrypt_ablkcipher_dec);
+}
+
+/* Spread the serialization callbacks of new transforms over the CPUs */
+static unsigned int pcrypt_pick_cb_cpu(struct pcrypt_instance_ctx *ictx)
+{
+	unsigned int cpu, cb_cpu;
+	int cpu_index;
 
 	ictx->tfm_count++;
 
 	cpu_index = ictx->tfm_count % cpumask_weight(cpu_active_mask);
 
-	ctx->cb_cpu = cpumask_first(cpu_active_mask);
+	cb_cpu = cpumask_first(cpu_active_mask);
 	for (cpu = 0; cpu < cpu_index; cpu++)
-		ctx->cb_cpu = cpumask_next(ctx->cb_cpu, cpu_active_mask);
+		cb_cpu = cpumask_next(cb_cpu, cpu_active_mask);
+
+	return cb_cpu;
+}
+
+static int pcrypt_aead_init_tfm(struct crypto_tfm *tfm)
+{
+	struct crypto_instance *inst = crypto_tfm_alg_instance(tfm);
+	struct pcrypt_instance_ctx *ictx = crypto_instance_ctx(inst);
+	struct pcrypt_aead_ctx *ctx = crypto_tfm_ctx(tfm);
+	struct crypto_aead *cipher;
+
+	ctx->cb_cpu = pcrypt_pick_cb_cpu(ictx);
 
 	cipher = crypto_spawn_aead(crypto_instance_ctx(inst));
 
@@ -306,6 +518,35 @@ static void pcrypt_aead_exit_tfm(struct crypto_tfm *tfm)
 	crypto_free_aead(ctx->child);
 }
 
+static int pcrypt_ablkcipher_init_tfm(struct crypto_tfm *tfm)
+{
+	struct crypto_instance *inst = crypto_tfm_alg_instance(tfm);
+	struct pcrypt_instance_ctx *ictx = crypto_instance_ctx(inst);
+	struct pcrypt_ablkcipher_ctx *ctx = crypto_tfm_ctx(tfm);
+	struct crypto_ablkcipher *cipher;
+
+	ctx->cb_cpu = pcrypt_pick_cb_cpu(ictx);
+
+	cipher = crypto_spawn_skcipher(crypto_instance_ctx(inst));
+
+	if (IS_ERR(cipher))
+		return PTR_ERR(cipher);
+
+	ctx->child = cipher;
+	tfm->crt_ablkcipher.reqsize = sizeof(struct pcrypt_request)
+		+ sizeof(struct ablkcipher_request)
+		+ crypto_ablkcipher_reqsize(cipher);
+
+	return 0;
+}
+
+static void pcrypt_ablkcipher_exit_tfm(struct crypto_tfm *tfm)
+{
+	struct pcrypt_ablkcipher_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	crypto_free_ablkcipher(ctx->child);
+}
+
 static struct crypto_instance *pcrypt_alloc_instance(struct crypto_alg *alg)
 {
 	struct crypto_instance *inst;
@@ -381,6 +622,54 @@ out_put_alg:
 	return inst;
 }
 
+static struct crypto_instance *pcrypt_alloc_ablkcipher(struct rtattr **tb,
+						       u32 type, u32 mask)
+{
+	struct crypto_instance *inst;
+	struct crypto_alg *alg;
+
+	alg = crypto_get_attr_alg(tb, type, crypto_skcipher_mask(mask));
+	if (IS_ERR(alg))
+		return ERR_CAST(alg);
+
+	inst = pcrypt_alloc_instance(alg);
+	if (IS_ERR(inst))
+		goto out_put_alg;
+
+	inst->alg.cra_flags = CRYPTO_ALG_TYPE_ABLKCIPHER | CRYPTO_ALG_ASYNC;
+	inst->alg.cra_type = &crypto_ablkcipher_type;
+
+	if ((alg->cra_flags & CRYPTO_ALG_TYPE_MASK) ==
+	    CRYPTO_ALG_TYPE_BLKCIPHER) {
+		inst->alg.cra_ablkcipher.ivsize = alg->cra_blkcipher.ivsize;
+		inst->alg.cra_ablkcipher.geniv = alg->cra_blkcipher.geniv;
+		inst->alg.cra_ablkcipher.min_keysize =
+			alg->cra_blkcipher.min_keysize;
+		inst->alg.cra_ablkcipher.max_keysize =
+			alg->cra_blkcipher.max_keysize;
+	} else {
+		inst->alg.cra_ablkcipher.ivsize = alg->cra_ablkcipher.ivsize;
+		inst->alg.cra_ablkcipher.geniv = alg->cra_ablkcipher.geniv;
+		inst->alg.cra_ablkcipher.min_keysize =
+			alg->cra_ablkcipher.min_keysize;
+		inst->alg.cra_ablkcipher.max_keysize =
+			alg->cra_ablkcipher.max_keysize;
+	}
+
+	inst->alg.cra_ctxsize = sizeof(struct pcrypt_ablkcipher_ctx);
+
+	inst->alg.cra_init = pcrypt_ablkcipher_init_tfm;
+	inst->alg.cra_exit = pcrypt_ablkcipher_exit_tfm;
+
+	inst->alg.cra_ablkcipher.setkey = pcrypt_ablkcipher_setkey;
+	inst->alg.cra_ablkcipher.encrypt = pcrypt_ablkcipher_encrypt;
+	inst->alg.cra_ablkcipher.decrypt = pcrypt_ablkcipher_decrypt;
+
+out_put_alg:
+	crypto_mod_put(alg);
+	return inst;
+}
+
 static struct crypto_instance *pcrypt_alloc(struct rtattr **tb)
 {
 	struct crypto_attr_type *algt;
@@ -392,6 +681,8 @@ static struct crypto_instance *pcrypt_alloc(struct rtattr **tb)
 	switch (algt->type & algt->mask & CRYPTO_ALG_TYPE_MASK) {
 	case CRYPTO_ALG_TYPE_AEAD:
 		return pcrypt_alloc_aead(tb, algt->type, algt->mask);
+	case CRYPTO_ALG_TYPE_BLKCIPHER:
+		return pcrypt_alloc_ablkcipher(tb, algt->type, algt->mask);
 	}
 
 	return ERR_PTR(-EINVAL);
@@ -460,6 +751,10 @@ static int pcrypt_init_padata(struct padata_pcrypt *pcrypt,
 	if (!pcrypt->wq)
 		goto err;
 
+	spin_lock_init(&pcrypt->backlog_lock);
+	INIT_LIST_HEAD(&pcrypt->backlog);
+	INIT_DELAYED_WORK(&pcrypt->backlog_work, pcrypt_backlog_work);
+
 	pcrypt->pinst = padata_alloc_possible(pcrypt->wq);
 	if (!pcrypt->pinst)
 		goto err_destroy_workqueue;
@@ -505,6 +800,8 @@ err:
 
 static void pcrypt_fini_padata(struct padata_pcrypt *pcrypt)
 {
+	cancel_delayed_work_sync(&pcrypt->backlog_work);
+
 	free_cpumask_var(pcrypt->cb_cpumask->mask);
 	kfree(pcrypt->cb_cpumask);
 
@@ -0,0 +1,493 @@
+/*
+ * Cryptographic API.
+ *
+ * Multi-buffer SHA-256 asynchronous hash.
+ *
+ * Independent finup/digest requests are queued per CPU, in the same way
+ * cryptd queues them, and a worker on the crypto workqueue gathers up to
+ * SHA256_MB_LANES of them at a time.  The compression function is then
+ * run over one block of every active lane in lockstep, which keeps the
+ * integer pipeline busy with independent dependency chains instead of
+ * stalling on a single stream.  Lanes are refilled from the queue as soon
+ * as a request finishes, so a steady stream of small digests (e.g. block
+ * hash verification of a read-only partition) is processed in batches.
+ *
+ * init/update/final/export/import are handled synchronously.
+ *
+ * Hashing one request on its own costs a trip through the workqueue, so
+ * the algorithm is not registered as "sha256", where it would replace
+ * sha256-generic for every ahash user.  Users that submit many requests
+ * at once ask for "sha256-mb" instead.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ */
+
+#include <crypto/algapi.h>
+#include <crypto/crypto_wq.h>
+#include <crypto/internal/hash.h>
+#include <crypto/scatterwalk.h>
+#include <crypto/sha.h>
+#include <linux/err.h>
+#include <linux/init.h>
+#include <linux/interrupt.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/percpu.h>
+#include <linux/sched.h>
+#include <linux/types.h>
+#include <asm/byteorder.h>
+
+#define SHA256_MB_LANES		4
+#define SHA256_MB_MAX_CPU_QLEN	100
+
+struct sha256_mb_reqctx {
+	struct sha256_state sctx;
+};
+
+struct sha256_mb_lane {
+	struct ahash_request *req;
+	struct sha256_state *sctx;
+	struct scatter_walk walk;
+	unsigned int left;		/* bytes still to be read from src */
+	unsigned int partial;		/* bytes buffered in buf */
+	unsigned int nfinal;		/* padding blocks, 0 until padded */
+	unsigned int next;		/* next padding block to emit */
+	u8 buf[2 * SHA256_BLOCK_SIZE];
+};
+
+struct sha256_mb_cpu {
+	struct crypto_queue queue;
+	struct work_struct work;
+	struct sha256_mb_lane lanes[SHA256_MB_LANES];
+};
+
+static struct sha256_mb_cpu __percpu *sha256_mb_cpus;
+
+static const u32 sha256_mb_K[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static inline u32 Ch(u32 x, u32 y, u32 z)
+{
+	return z ^ (x & (y ^ z));
+}
+
+static inline u32 Maj(u32 x, u32 y, u32 z)
+{
+	return (x & y) | (z & (x | y));
+}
+
+#define e0(x)       (ror32(x, 2) ^ ror32(x,13) ^ ror32(x,22))
+#define e1(x)       (ror32(x, 6) ^ ror32(x,11) ^ ror32(x,25))
+#define s0(x)       (ror32(x, 7) ^ ror32(x,18) ^ (x >> 3))
+#define s1(x)       (ror32(x,17) ^ ror32(x,19) ^ (x >> 10))
+
+/*
+ * Compress one 64 byte block for each of @lanes independent streams.
+ * The rounds of all lanes are interleaved so the compiler can schedule
+ * the independent dependency chains together; the message schedule is
+ * kept in a 16 word ring per lane to bound stack usage.
+ */
+static void sha256_mb_transform(u32 *state[], const u8 *data[], int lanes)
+{
+	u32 W[SHA256_MB_LANES][16];
+	u32 v[SHA256_MB_LANES][8];
+	u32 t1, t2, w;
+	int i, l;
+
+	for (l = 0; l < lanes; l++)
+		memcpy(v[l], state[l], sizeof(v[l]));
+
+	for (i = 0; i < 64; i++) {
+		for (l = 0; l < lanes; l++) {
+			u32 *x = v[l];
+
+			if (i < 16) {
+				w = be32_to_cpu(((__be32 *)data[l])[i]);
+			} else {
+				w = s1(W[l][(i - 2) & 15]) + W[l][(i - 7) & 15] +
+				    s0(W[l][(i - 15) & 15]) + W[l][i & 15];
+			}
+			W[l][i & 15] = w;
+
+			t1 = x[7] + e1(x[4]) + Ch(x[4], x[5], x[6]) +
+			     sha256_mb_K[i] + w;
+			t2 = e0(x[0]) + Maj(x[0], x[1], x[2]);
+			x[7] = x[6];
+			x[6] = x[5];
+			x[5] = x[4];
+			x[4] = x[3] + t1;
+			x[3] = x[2];
+			x[2] = x[1];
+			x[1] = x[0];
+			x[0] = t1 + t2;
+		}
+	}
+
+	for (l = 0; l < lanes; l++) {
+		for (i = 0; i < 8; i++)
+			state[l][i] += v[l][i];
+	}
+
+	/* clear any sensitive info... */
+	memset(W, 0, sizeof(W));
+	memset(v, 0, sizeof(v));
+}
+
+static void sha256_mb_update_one(struct sha256_state *sctx, const u8 *data,
+				 unsigned int len)
+{
+	unsigned int partial, done;
+	const u8 *src;
+	u32 *state = sctx->state;
+
+	partial = sctx->count & 0x3f;
+	sctx->count += len;
+	done = 0;
+	src = data;
+
+	if ((partial + len) > 63) {
+		if (partial) {
+			done = -partial;
+			memcpy(sctx->buf + partial, data, done + 64);
+			src = sctx->buf;
+		}
+
+		do {
+			sha256_mb_transform(&state, &src, 1);
+			done += 64;
+			src = data + done;
+		} while (done + 63 < len);
+
+		partial = 0;
+	}
+	memcpy(sctx->buf + partial, src, len - done);
+}
+
+static void sha256_mb_output(struct sha256_state *sctx, u8 *out)
+{
+	__be32 *dst = (__be32 *)out;
+	int i;
+
+	for (i = 0; i < 8; i++)
+		dst[i] = cpu_to_be32(sctx->state[i]);
+
+	/* Zeroize sensitive information. */
+	memset(sctx, 0, sizeof(*sctx));
+}
+
+static int sha256_mb_init(struct ahash_request *req)
+{
+	struct sha256_mb_reqctx *rctx = ahash_request_ctx(req);
+	struct sha256_state *sctx = &rctx->sctx;
+
+	sctx->state[0] = SHA256_H0;
+	sctx->state[1] = SHA256_H1;
+	sctx->state[2] = SHA256_H2;
+	sctx->state[3] = SHA256_H3;
+	sctx->state[4] = SHA256_H4;
+	sctx->state[5] = SHA256_H5;
+	sctx->state[6] = SHA256_H6;
+	sctx->state[7] = SHA256_H7;
+	sctx->count = 0;
+
+	return 0;
+}
+
+static int sha256_mb_update(struct ahash_request *req)
+{
+	struct sha256_mb_reqctx *rctx = ahash_request_ctx(req);
+	struct crypto_hash_walk walk;
+	int nbytes;
+
+	for (nbytes = crypto_hash_walk_first(req, &walk); nbytes > 0;
+	     nbytes = crypto_hash_walk_done(&walk, 0))
+		sha256_mb_update_one(&rctx->sctx, walk.data, nbytes);
+
+	return nbytes;
+}
+
+static int sha256_mb_final(struct ahash_request *req)
+{
+	struct sha256_mb_reqctx *rctx = ahash_request_ctx(req);
+	struct sha256_state *sctx = &rctx->sctx;
+	static const u8 padding[64] = { 0x80, };
+	unsigned int index, pad_len;
+	__be64 bits;
+
+	/* Save number of bits */
+	bits = cpu_to_be64(sctx->count << 3);
+
+	/* Pad out to 56 mod 64. */
+	index = sctx->count & 0x3f;
+	pad_len = (index < 56) ? (56 - index) : ((64+56) - index);
+	sha256_mb_update_one(sctx, padding, pad_len);
+
+	/* Append length (before padding) */
+	sha256_mb_update_one(sctx, (const u8 *)&bits, sizeof(bits));
+
+	sha256_mb_output(sctx, req->result);
+
+	return 0;
+}
+
+static int sha256_mb_export(struct ahash_request *req, void *out)
+{
+	struct sha256_mb_reqctx *rctx = ahash_request_ctx(req);
+
+	memcpy(out, &rctx->sctx, sizeof(rctx->sctx));
+	return 0;
+}
+
+static int sha256_mb_import(struct ahash_request *req, const void *in)
+{
+	struct sha256_mb_reqctx *rctx = ahash_request_ctx(req);
+
+	memcpy(&rctx->sctx, in, sizeof(rctx->sctx));
+	return 0;
+}
+
+static int sha256_mb_finup(struct ahash_request *req)
+{
+	struct sha256_mb_cpu *mcpu;
+	int cpu, err;
+
+	cpu = get_cpu();
+	mcpu = this_cpu_ptr(sha256_mb_cpus);
+	err = crypto_enqueue_request(&mcpu->queue, &req->base);
+	queue_work_on(cpu, kcrypto_wq, &mcpu->work);
+	put_cpu();
+
+	return err;
+}
+
+static int sha256_mb_digest(struct ahash_request *req)
+{
+	sha256_mb_init(req);
+	return sha256_mb_finup(req);
+}
+
+/* Set up the final one or two blocks once the source is exhausted. */
+static void sha256_mb_lane_pad(struct sha256_mb_lane *lane)
+{
+	unsigned int partial = lane->partial;
+	__be64 bits = cpu_to_be64(lane->sctx->count << 3);
+
+	lane->buf[partial++] = 0x80;
+	lane->nfinal = partial <= SHA256_BLOCK_SIZE - sizeof(bits) ? 1 : 2;
+	memset(lane->buf + partial, 0,
+	       lane->nfinal * SHA256_BLOCK_SIZE - sizeof(bits) - partial);
+	memcpy(lane->buf + lane->nfinal * SHA256_BLOCK_SIZE - sizeof(bits),
+	       &bits, sizeof(bits));
+	lane->next = 0;
+}
+
+static const u8 *sha256_mb_lane_next(struct sha256_mb_lane *lane)
+{
+	unsigned int n;
+
+	if (!lane->nfinal) {
+		n = min(lane->left, SHA256_BLOCK_SIZE - lane->partial);
+		if (n) {
+			scatterwalk_copychunks(lane->buf + lane->partial,
+					       &lane->walk, n, 0);
+			lane->left -= n;
+			scatterwalk_done(&lane->walk, 0, lane->left);
+			lane->partial += n;
+		}
+
+		if (lane->partial == SHA256_BLOCK_SIZE) {
+			lane->partial = 0;
+			return lane->buf;
+		}
+
+		sha256_mb_lane_pad(lane);
+	}
+
+	return lane->buf + lane->next++ * SHA256_BLOCK_SIZE;
+}
+
+static bool sha256_mb_lane_fill(struct sha256_mb_cpu *mcpu,
+				struct sha256_mb_lane *lane)
+{
+	struct crypto_async_request *areq, *backlog;
+	struct sha256_mb_reqctx *rctx;
+	struct ahash_request *req;
+
+	/* Keep softirq enqueuers on this CPU out of the queue. */
+	local_bh_disable();
+	backlog = crypto_get_backlog(&mcpu->queue);
+	areq = crypto_dequeue_request(&mcpu->queue);
+	if (backlog)
+		backlog->complete(backlog, -EINPROGRESS);
+	local_bh_enable();
+
+	if (!areq)
+		return false;
+
+	req = ahash_request_cast(areq);
+	rctx = ahash_request_ctx(req);
+
+	lane->req = req;
+	lane->sctx = &rctx->sctx;
+	lane->partial = rctx->sctx.count & 0x3f;
+	lane->left = req->nbytes;
+	lane->nfinal = 0;
+	memcpy(lane->buf, rctx->sctx.buf, lane->partial);
+	rctx->sctx.count += req->nbytes;
+	if (lane->left)
+		scatterwalk_start(&lane->walk, req->src);
+
+	return true;
+}
+
+static void sha256_mb_lane_complete(struct sha256_mb_lane *lane)
+{
+	struct ahash_request *req = lane->req;
+
+	sha256_mb_output(lane->sctx, req->result);
+	memset(lane->buf, 0, sizeof(lane->buf));
+	lane->req = NULL;
+
+	local_bh_disable();
+	req->base.complete(&req->base, 0);
+	local_bh_enable();
+}
+
+/*
+ * Called in workqueue context.  Runs the lanes in lockstep, refilling
+ * them from the per-CPU queue as requests finish, and reschedules itself
+ * rather than hog the CPU when a reschedule is pending.  Lane state lives
+ * in the per-CPU structure so it survives being rescheduled.
+ */
+static void sha256_mb_worker(struct work_struct *work)
+{
+	struct sha256_mb_cpu *mcpu;
+	struct sha256_mb_lane *lane;
+	u32 *state[SHA256_MB_LANES];
+	const u8 *data[SHA256_MB_LANES];
+	int i, n;
+
+	mcpu = container_of(work, struct sha256_mb_cpu, work);
+
+	for (;;) {
+		n = 0;
+		for (i = 0; i < SHA256_MB_LANES; i++) {
+			lane = &mcpu->lanes[i];
+			if (!lane->req && !sha256_mb_lane_fill(mcpu, lane))
+				continue;
+			state[n] = lane->sctx->state;
+			data[n] = sha256_mb_lane_next(lane);
+			n++;
+		}
+
+		if (!n)
+			return;
+
+		sha256_mb_transform(state, data, n);
+
+		for (i = 0; i < SHA256_MB_LANES; i++) {
+			lane = &mcpu->lanes[i];
+			if (lane->req && lane->nfinal &&
+			    lane->next == lane->nfinal)
+				sha256_mb_lane_complete(lane);
+		}
+
+		if (need_resched()) {
+			queue_work(kcrypto_wq, &mcpu->work);
+			return;
+		}
+	}
+}
+
+static int sha256_mb_init_tfm(struct crypto_tfm *tfm)
+{
+	crypto_ahash_set_reqsize(__crypto_ahash_cast(tfm),
+				 sizeof(struct sha256_mb_reqctx));
+	return 0;
+}
+
+static struct ahash_alg sha256_mb_alg = {
+	.init		=	sha256_mb_init,
+	.update		=	sha256_mb_update,
+	.final		=	sha256_mb_final,
+	.finup		=	sha256_mb_finup,
+	.digest		=	sha256_mb_digest,
+	.export		=	sha256_mb_export,
+	.import		=	sha256_mb_import,
+	.halg		=	{
+		.digestsize	=	SHA256_DIGEST_SIZE,
+		.statesize	=	sizeof(struct sha256_state),
+		.base		=	{
+			.cra_name	=	"sha256-mb",
+			.cra_driver_name=	"sha256-mb",
+			.cra_flags	=	CRYPTO_ALG_ASYNC,
+			.cra_blocksize	=	SHA256_BLOCK_SIZE,
+			.cra_init	=	sha256_mb_init_tfm,
+			.cra_module	=	THIS_MODULE,
+		}
+	}
+};
+
+static int __init sha256_mb_mod_init(void)
+{
+	struct sha256_mb_cpu *mcpu;
+	int cpu, err;
+
+	sha256_mb_cpus = alloc_percpu(struct sha256_mb_cpu);
+	if (!sha256_mb_cpus)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		mcpu = per_cpu_ptr(sha256_mb_cpus, cpu);
+		crypto_init_queue(&mcpu->queue, SHA256_MB_MAX_CPU_QLEN);
+		INIT_WORK(&mcpu->work, sha256_mb_worker);
+	}
+
+	err = crypto_register_ahash(&sha256_mb_alg);
+	if (err)
+		free_percpu(sha256_mb_cpus);
+
+	return err;
+}
+
+static void __exit sha256_mb_mod_fini(void)
+{
+	struct sha256_mb_cpu *mcpu;
+	int cpu;
+
+	crypto_unregister_ahash(&sha256_mb_alg);
+
+	for_each_possible_cpu(cpu) {
+		mcpu = per_cpu_ptr(sha256_mb_cpus, cpu);
+		flush_work_sync(&mcpu->work);
+		BUG_ON(mcpu->queue.qlen);
+	}
+	free_percpu(sha256_mb_cpus);
+}
+
+module_init(sha256_mb_mod_init);
+module_exit(sha256_mb_mod_fini);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Multi-buffer SHA-256 Secure Hash Algorithm");
+MODULE_ALIAS("sha256");
@@ -26,6 +26,7 @@
 #include <linux/err.h>
 #include <linux/init.h>
 #include <linux/gfp.h>
+#include <linux/slab.h>
 #include <linux/module.h>
 #include <linux/scatterlist.h>
 #include <linux/string.h>
@@ -64,7 +65,7 @@ static char *check[] = {
 	"cast6", "arc4", "michael_mic", "deflate", "crc32c", "tea", "xtea",
 	"khazad", "wp512", "wp384", "wp256", "tnepres", "xeta",  "fcrypt",
 	"camellia", "seed", "salsa20", "rmd128", "rmd160", "rmd256", "rmd320",
-	"lzo", "cts", "zlib", NULL
+	"lzo", "cts", "zlib", "lz4", NULL
 };
 
 static int test_cipher_jiffies(struct blkcipher_desc *desc, int enc,
@@ -719,6 +720,392 @@ out:
 	crypto_free_ahash(tfm);
 }
 
+struct tcrypt_depth_result {
+	struct completion completion;
+	atomic_t pending;
+	int err;
+};
+
+static void tcrypt_depth_complete(struct crypto_async_request *req, int err)
+{
+	struct tcrypt_depth_result *res = req->data;
+
+	if (err == -EINPROGRESS)
+		return;
+
+	if (err)
+		res->err = err;
+	if (atomic_dec_and_test(&res->pending))
+		complete(&res->completion);
+}
+
+static u32 depth_sizes[] = { 1, 2, 4, 8, 16, 32, 0 };
+
+/*
+ * Keep "depth" independent digest requests in flight at a time and report
+ * how many complete per second.  This is what batching implementations
+ * (e.g. multi-buffer hashes) are meant to improve.
+ */
+static void test_ahash_depth_speed(const char *algo, unsigned int sec,
+				   struct hash_speed *speed)
+{
+	struct ahash_request *req[32];
+	struct tcrypt_depth_result res;
+	struct scatterlist sg[TVMEMSIZE];
+	struct crypto_ahash *tfm;
+	static char output[32 * 64];
+	unsigned long start, end;
+	unsigned int dsize;
+	int i, j, k, ret, bcount;
+
+	printk(KERN_INFO "\ntesting queue depth speed of async %s\n", algo);
+
+	if (!sec)
+		sec = 1;
+
+	tfm = crypto_alloc_ahash(algo, 0, 0);
+	if (IS_ERR(tfm)) {
+		pr_err("failed to load transform for %s: %ld\n",
+		       algo, PTR_ERR(tfm));
+		return;
+	}
+
+	dsize = crypto_ahash_digestsize(tfm);
+	if (dsize > 64) {
+		pr_err("digestsize(%u) > 64\n", dsize);
+		goto out;
+	}
+
+	test_hash_sg_init(sg);
+	init_completion(&res.completion);
+
+	for (i = 0; i < ARRAY_SIZE(req); i++) {
+		req[i] = ahash_request_alloc(tfm, GFP_KERNEL);
+		if (!req[i]) {
+			pr_err("ahash request allocation failure\n");
+			goto out_free_req;
+		}
+		ahash_request_set_callback(req[i], CRYPTO_TFM_REQ_MAY_BACKLOG,
+					   tcrypt_depth_complete, &res);
+	}
+
+	for (i = 0; speed[i].blen != 0; i++) {
+		if (speed[i].blen > TVMEMSIZE * PAGE_SIZE) {
+			pr_err("template (%u) too big for tvmem (%lu)\n",
+			       speed[i].blen, TVMEMSIZE * PAGE_SIZE);
+			break;
+		}
+
+		for (j = 0; depth_sizes[j] != 0; j++) {
+			pr_info("test%3u (%5u byte blocks, depth %2u): ",
+				i, speed[i].blen, depth_sizes[j]);
+
+			res.err = 0;
+			for (start = jiffies, end = start + sec * HZ, bcount = 0;
+			     time_before(jiffies, end);
+			     bcount += depth_sizes[j]) {
+				atomic_set(&res.pending, depth_sizes[j] + 1);
+				for (k = 0; k < depth_sizes[j]; k++) {
+					ahash_request_set_crypt(req[k], sg,
+						output + k * 64, speed[i].blen);
+					ret = crypto_ahash_digest(req[k]);
+					if (ret == -EINPROGRESS || ret == -EBUSY)
+						continue;
+					if (ret)
+						res.err = ret;
+					atomic_dec(&res.pending);
+				}
+				if (!atomic_dec_and_test(&res.pending))
+					wait_for_completion(&res.completion);
+				INIT_COMPLETION(res.completion);
+				if (res.err)
+					break;
+			}
+
+			if (res.err) {
+				pr_err("hashing failed ret=%d\n", res.err);
+				goto out_free_req;
+			}
+
+			pr_cont("%8u requests/sec, %9lu bytes/sec\n",
+				bcount / sec, ((long)bcount * speed[i].blen) / sec);
+		}
+	}
+
+out_free_req:
+	for (i = 0; i < ARRAY_SIZE(req) && req[i]; i++)
+		ahash_request_free(req[i]);
+out:
+	crypto_free_ahash(tfm);
+}
+
+static u32 depth_block_sizes[] = { 512, 4096, 0 };
+
+/*
+ * Same as test_ahash_depth_speed() for block ciphers, with the sector and
+ * page sizes a block encryption target submits.  pcrypt hands consecutive
+ * requests to consecutive CPUs of its parallel cpumask, so a depth of d
+ * keeps up to d CPUs busy; the CPU column gives that number.  To measure
+ * fewer CPUs, restrict /sys/kernel/pcrypt/pencrypt/parallel_cpumask.
+ */
+static void test_acipher_depth_speed(const char *algo, unsigned int sec,
+				     u32 *b_size)
+{
+	struct ablkcipher_request *req[32];
+	struct tcrypt_depth_result res;
+	struct scatterlist sg[32];
+	struct crypto_ablkcipher *tfm;
+	static char key[16];
+	static u8 iv[32][16];
+	char *buf[32];
+	unsigned long start, end;
+	unsigned int cpus;
+	int i, j, k, ret, bcount;
+
+	printk(KERN_INFO "\ntesting queue depth speed of async %s "
+	       "encryption\n", algo);
+
+	if (!sec)
+		sec = 1;
+
+	memset(req, 0, sizeof(req));
+	memset(buf, 0, sizeof(buf));
+
+	tfm = crypto_alloc_ablkcipher(algo, 0, 0);
+	if (IS_ERR(tfm)) {
+		pr_err("failed to load transform for %s: %ld\n",
+		       algo, PTR_ERR(tfm));
+		return;
+	}
+
+	ret = crypto_ablkcipher_setkey(tfm, key, sizeof(key));
+	if (ret) {
+		pr_err("setkey() failed flags=%x\n",
+		       crypto_ablkcipher_get_flags(tfm));
+		goto out;
+	}
+
+	init_completion(&res.completion);
+
+	for (i = 0; i < ARRAY_SIZE(req); i++) {
+		buf[i] = kzalloc(PAGE_SIZE, GFP_KERNEL);
+		req[i] = ablkcipher_request_alloc(tfm, GFP_KERNEL);
+		if (!buf[i] || !req[i]) {
+			pr_err("ablkcipher request allocation failure\n");
+			goto out_free_req;
+		}
+		ablkcipher_request_set_callback(req[i],
+						CRYPTO_TFM_REQ_MAY_BACKLOG |
+						CRYPTO_TFM_REQ_MAY_SLEEP,
+						tcrypt_depth_complete, &res);
+	}
+
+	for (i = 0; b_size[i] != 0; i++) {
+		if (b_size[i] > PAGE_SIZE) {
+			pr_err("template (%u) too big for a page\n", b_size[i]);
+			break;
+		}
+
+		for (j = 0; depth_sizes[j] != 0; j++) {
+			cpus = min_t(unsigned int, depth_sizes[j],
+				     num_online_cpus());
+			pr_info("test%3u (%5u byte blocks, depth %2u, "
+				"%u cpus): ", i, b_size[i], depth_sizes[j],
+				cpus);
+
+			res.err = 0;
+			for (start = jiffies, end = start + sec * HZ, bcount = 0;
+			     time_before(jiffies, end);
+			     bcount += depth_sizes[j]) {
+				atomic_set(&res.pending, depth_sizes[j] + 1);
+				for (k = 0; k < depth_sizes[j]; k++) {
+					sg_init_one(&sg[k], buf[k], b_size[i]);
+					ablkcipher_request_set_crypt(req[k],
+						&sg[k], &sg[k], b_size[i],
+						iv[k]);
+					ret = crypto_ablkcipher_encrypt(req[k]);
+					if (ret == -EINPROGRESS || ret == -EBUSY)
+						continue;
+					if (ret)
+						res.err = ret;
+					atomic_dec(&res.pending);
+				}
+				if (!atomic_dec_and_test(&res.pending))
+					wait_for_completion(&res.completion);
+				INIT_COMPLETION(res.completion);
+				if (res.err)
+					break;
+			}
+
+			if (res.err) {
+				pr_err("encryption failed ret=%d\n", res.err);
+				goto out_free_req;
+			}
+
+			pr_cont("%8u requests/sec, %9lu bytes/sec\n",
+				bcount / sec, ((long)bcount * b_size[i]) / sec);
+		}
+	}
+
+out_free_req:
+	for (i = 0; i < ARRAY_SIZE(req); i++) {
+		if (req[i])
+			ablkcipher_request_free(req[i]);
+		kfree(buf[i]);
+	}
+out:
+	crypto_free_ablkcipher(tfm);
+}
+
+#define ORDER_REQS	128
+
+struct tcrypt_order_result {
+	struct completion completion;
+	spinlock_t lock;
+	unsigned int next;
+	unsigned int done;
+	unsigned int misordered;
+	int err;
+};
+
+struct tcrypt_order_req {
+	struct tcrypt_order_result *res;
+	unsigned int seq;
+	u8 iv[16];
+};
+
+static void tcrypt_order_complete(struct crypto_async_request *req, int err)
+{
+	struct tcrypt_order_req *oreq = req->data;
+	struct tcrypt_order_result *res = oreq->res;
+	unsigned long flags;
+
+	if (err == -EINPROGRESS)
+		return;
+
+	spin_lock_irqsave(&res->lock, flags);
+	if (err && !res->err)
+		res->err = err;
+	if (oreq->seq != res->next)
+		res->misordered++;
+	res->next = oreq->seq + 1;
+	if (++res->done == ORDER_REQS)
+		complete(&res->completion);
+	spin_unlock_irqrestore(&res->lock, flags);
+}
+
+/*
+ * Submit a burst of requests of alternating size and check that their
+ * completions are called in submission order, as pcrypt promises, and
+ * that decryption gives back the original data.  The small requests
+ * finish their parallel part first, so a missing reorder shows up.
+ */
+static int test_acipher_order(const char *algo)
+{
+	static struct ablkcipher_request *req[ORDER_REQS];
+	static struct tcrypt_order_req oreq[ORDER_REQS];
+	static struct scatterlist sg[ORDER_REQS];
+	static char *buf[ORDER_REQS];
+	static char key[16];
+	struct tcrypt_order_result res;
+	struct crypto_ablkcipher *tfm;
+	unsigned int len, j;
+	int i, pass, ret;
+
+	printk(KERN_INFO "\ntesting completion order of %s\n", algo);
+
+	tfm = crypto_alloc_ablkcipher(algo, 0, 0);
+	if (IS_ERR(tfm)) {
+		if (PTR_ERR(tfm) == -ENOENT)
+			return 0;
+		printk(KERN_ERR "alg: order: failed to load %s: %ld\n",
+		       algo, PTR_ERR(tfm));
+		return PTR_ERR(tfm);
+	}
+
+	memset(req, 0, sizeof(req));
+	memset(buf, 0, sizeof(buf));
+
+	ret = crypto_ablkcipher_setkey(tfm, key, sizeof(key));
+	if (ret)
+		goto out;
+
+	ret = -ENOMEM;
+	for (i = 0; i < ORDER_REQS; i++) {
+		buf[i] = kmalloc(PAGE_SIZE, GFP_KERNEL);
+		req[i] = ablkcipher_request_alloc(tfm, GFP_KERNEL);
+		if (!buf[i] || !req[i])
+			goto out_free_req;
+		memset(buf[i], i, PAGE_SIZE);
+		oreq[i].res = &res;
+		oreq[i].seq = i;
+		ablkcipher_request_set_callback(req[i],
+						CRYPTO_TFM_REQ_MAY_BACKLOG |
+						CRYPTO_TFM_REQ_MAY_SLEEP,
+						tcrypt_order_complete, &oreq[i]);
+	}
+
+	for (pass = 0; pass < 2; pass++) {
+		init_completion(&res.completion);
+		spin_lock_init(&res.lock);
+		res.next = res.done = res.misordered = 0;
+		res.err = 0;
+
+		for (i = 0; i < ORDER_REQS; i++) {
+			len = i & 1 ? 16 : PAGE_SIZE;
+			memset(oreq[i].iv, 0, sizeof(oreq[i].iv));
+			sg_init_one(&sg[i], buf[i], len);
+			ablkcipher_request_set_crypt(req[i], &sg[i], &sg[i],
+						     len, oreq[i].iv);
+			ret = pass ? crypto_ablkcipher_decrypt(req[i]) :
+				     crypto_ablkcipher_encrypt(req[i]);
+			if (ret != -EINPROGRESS && ret != -EBUSY)
+				tcrypt_order_complete(&req[i]->base, ret);
+		}
+
+		wait_for_completion(&res.completion);
+
+		ret = res.err;
+		if (ret) {
+			printk(KERN_ERR "alg: order: %s failed for %s: %d\n",
+			       pass ? "decryption" : "encryption", algo, ret);
+			goto out_free_req;
+		}
+		if (res.misordered) {
+			printk(KERN_ERR "alg: order: %u of %u %s completions "
+			       "out of order for %s\n", res.misordered,
+			       ORDER_REQS, pass ? "decryption" : "encryption",
+			       algo);
+			ret = -EINVAL;
+			goto out_free_req;
+		}
+	}
+
+	for (i = 0; i < ORDER_REQS; i++) {
+		for (j = 0; j < PAGE_SIZE; j++) {
+			if (buf[i][j] == (char)i)
+				continue;
+			printk(KERN_ERR "alg: order: round trip failed on "
+			       "request %d for %s\n", i, algo);
+			ret = -EINVAL;
+			goto out_free_req;
+		}
+	}
+
+	printk(KERN_INFO "alg: order: %u requests completed in order\n",
+	       ORDER_REQS);
+
+out_free_req:
+	for (i = 0; i < ORDER_REQS; i++) {
+		if (req[i])
+			ablkcipher_request_free(req[i]);
+		kfree(buf[i]);
+	}
+out:
+	crypto_free_ablkcipher(tfm);
+	return ret;
+}
+
 static void test_available(void)
 {
 	char **name = check;
@@ -948,6 +1335,10 @@ static int do_test(int m)
 		ret += tcrypt_test("ofb(aes)");
 		break;
 
+	case 47:
+		ret += tcrypt_test("lz4");
+		break;
+
 	case 100:
 		ret += tcrypt_test("hmac(md5)");
 		break;
@@ -1000,6 +1391,10 @@ static int do_test(int m)
 		ret += tcrypt_test("rfc4106(gcm(aes))");
 		break;
 
+	case 152:
+		ret += test_acipher_order("pcrypt(cbc(aes))");
+		break;
+
 	case 200:
 		test_cipher_speed("ecb(aes)", ENCRYPT, sec, NULL, 0,
 				speed_template_16_24_32);
@@ -1236,9 +1631,28 @@ static int do_test(int m)
 		test_ahash_speed("rmd320", sec, generic_hash_speed_template);
 		if (mode > 400 && mode < 500) break;
 
+	case 418:
+		test_ahash_depth_speed("sha256-mb", sec,
+				       depth_hash_speed_template);
+		if (mode > 400 && mode < 500) break;
+
+	case 419:
+		test_ahash_depth_speed("cryptd(sha256-generic)", sec,
+				       depth_hash_speed_template);
+		if (mode > 400 && mode < 500) break;
+
 	case 499:
 		break;
 
+	case 500:
+		test_acipher_depth_speed("pcrypt(cbc(aes))", sec,
+					 depth_block_sizes);
+		break;
+
+	case 501:
+		test_acipher_depth_speed("cbc(aes)", sec, depth_block_sizes);
+		break;
+
 	case 1000:
 		test_available();
 		break;
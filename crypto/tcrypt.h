@@ -112,4 +112,16 @@ static struct hash_speed hash_speed_template_16[] = {
 	{  .blen = 0,	.plen = 0,	.klen = 0, }
 };
 
+/*
+ * Digest speed tests for many independent in-flight requests
+ */
+static struct hash_speed depth_hash_speed_template[] = {
+	{ .blen = 64,	.plen = 64, },
+	{ .blen = 512,	.plen = 512, },
+	{ .blen = 4096,	.plen = 4096, },
+
+	/* End marker */
+	{  .blen = 0,	.plen = 0, }
+};
+
 #endif	/* _CRYPTO_TCRYPT_H */
@@ -30,6 +30,7 @@
 #include <linux/highmem.h>
 #include <linux/slab.h>
 #include <linux/lzo.h>
+#include <linux/lz4.h>
 #include <linux/string.h>
 #include <linux/vmalloc.h>
 
@@ -104,6 +105,36 @@ static int page_zero_filled(void *ptr)
 	return 1;
 }
 
+#ifdef CONFIG_ZRAM_LZ4_COMPRESS
+#define ZRAM_COMPRESS_WORKMEM	LZ4_MEM_COMPRESS
+
+static int zram_compress(const unsigned char *src, unsigned char *dst,
+			 size_t *dst_len, void *wrkmem)
+{
+	return lz4_compress(src, PAGE_SIZE, dst, dst_len, wrkmem);
+}
+
+static int zram_decompress(const unsigned char *src, size_t src_len,
+			   unsigned char *dst, size_t *dst_len)
+{
+	return lz4_decompress_unknownoutputsize(src, src_len, dst, dst_len);
+}
+#else
+#define ZRAM_COMPRESS_WORKMEM	LZO1X_MEM_COMPRESS
+
+static int zram_compress(const unsigned char *src, unsigned char *dst,
+			 size_t *dst_len, void *wrkmem)
+{
+	return lzo1x_1_compress(src, PAGE_SIZE, dst, dst_len, wrkmem);
+}
+
+static int zram_decompress(const unsigned char *src, size_t src_len,
+			   unsigned char *dst, size_t *dst_len)
+{
+	return lzo1x_decompress_safe(src, src_len, dst, dst_len);
+}
+#endif
+
 static void zram_set_disksize(struct zram *zram, size_t totalram_bytes)
 {
 	if (!zram->disksize) {
@@ -257,9 +288,9 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 	cmem = kmap_atomic(zram->table[index].page, KM_USER1) +
 		zram->table[index].offset;
 
-	ret = lzo1x_decompress_safe(cmem + sizeof(*zheader),
-				    xv_get_object_size(cmem) - sizeof(*zheader),
-				    uncmem, &clen);
+	ret = zram_decompress(cmem + sizeof(*zheader),
+			      xv_get_object_size(cmem) - sizeof(*zheader),
+			      uncmem, &clen);
 
 	if (is_partial_io(bvec)) {
 		memcpy(user_mem + bvec->bv_offset, uncmem + offset,
@@ -305,9 +336,9 @@ static int zram_read_before_write(struct zram *zram, char *mem, u32 index)
 		return 0;
 	}
 
-	ret = lzo1x_decompress_safe(cmem + sizeof(*zheader),
-				    xv_get_object_size(cmem) - sizeof(*zheader),
-				    mem, &clen);
+	ret = zram_decompress(cmem + sizeof(*zheader),
+			      xv_get_object_size(cmem) - sizeof(*zheader),
+			      mem, &clen);
 	kunmap_atomic(cmem, KM_USER0);
 
 	/* Should NEVER happen. Return bio error if it does. */
@@ -377,8 +408,7 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 		goto out;
 	}
 
-	ret = lzo1x_1_compress(uncmem, PAGE_SIZE, src, &clen,
-			       zram->compress_workmem);
+	ret = zram_compress(uncmem, src, &clen, zram->compress_workmem);
 
 	kunmap_atomic(user_mem, KM_USER0);
 	if (is_partial_io(bvec))
@@ -634,7 +664,7 @@ int zram_init_device(struct zram *zram)
 
 	zram_set_disksize(zram, totalram_pages << PAGE_SHIFT);
 
-	zram->compress_workmem = kzalloc(LZO1X_MEM_COMPRESS, GFP_KERNEL);
+	zram->compress_workmem = kzalloc(ZRAM_COMPRESS_WORKMEM, GFP_KERNEL);
 	if (!zram->compress_workmem) {
 		pr_err("Error allocating compressor working memory!\n");
 		ret = -ENOMEM;
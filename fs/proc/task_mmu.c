@@ -2,6 +2,7 @@
 #include <linux/hugetlb.h>
 #include <linux/huge_mm.h>
 #include <linux/mount.h>
+#include <linux/ctype.h>
 #include <linux/seq_file.h>
 #include <linux/highmem.h>
 #include <linux/ptrace.h>
@@ -11,6 +12,7 @@
 #include <linux/rmap.h>
 #include <linux/swap.h>
 #include <linux/swapops.h>
+#include <linux/mm_inline.h>
 
 #include <asm/elf.h>
 #include <asm/uaccess.h>
@@ -593,6 +595,155 @@ const struct file_operations proc_clear_refs_operations = {
 	.llseek		= noop_llseek,
 };
 
+#ifdef CONFIG_PROCESS_RECLAIM
+struct reclaim_walk {
+	struct vm_area_struct *vma;
+	unsigned long nr_to_reclaim;
+	unsigned long nr_reclaimed;
+};
+
+static int reclaim_pte_range(pmd_t *pmd, unsigned long addr,
+			     unsigned long end, struct mm_walk *walk)
+{
+	struct reclaim_walk *rw = walk->private;
+	struct vm_area_struct *vma = rw->vma;
+	unsigned long nr_isolated = 0;
+	LIST_HEAD(page_list);
+	pte_t *orig_pte, *pte, ptent;
+	spinlock_t *ptl;
+	struct page *page;
+
+	split_huge_page_pmd(walk->mm, pmd);
+
+	orig_pte = pte = pte_offset_map_lock(vma->vm_mm, pmd, addr, &ptl);
+	for (; addr != end; pte++, addr += PAGE_SIZE) {
+		ptent = *pte;
+		if (!pte_present(ptent))
+			continue;
+
+		page = vm_normal_page(vma, addr, ptent);
+		if (!page)
+			continue;
+
+		/* Leave pages shared with other processes alone */
+		if (page_mapcount(page) != 1)
+			continue;
+
+		if (isolate_lru_page(page))
+			continue;
+
+		list_add(&page->lru, &page_list);
+		inc_zone_page_state(page, NR_ISOLATED_ANON +
+				    page_is_file_cache(page));
+		if (rw->nr_reclaimed + ++nr_isolated >= rw->nr_to_reclaim)
+			break;
+	}
+	pte_unmap_unlock(orig_pte, ptl);
+
+	if (nr_isolated)
+		rw->nr_reclaimed += reclaim_pages_from_list(&page_list);
+	cond_resched();
+
+	if (rw->nr_reclaimed >= rw->nr_to_reclaim || fatal_signal_pending(current))
+		return 1;
+	return 0;
+}
+
+enum reclaim_type {
+	RECLAIM_FILE,
+	RECLAIM_ANON,
+	RECLAIM_ALL,
+};
+
+static ssize_t reclaim_write(struct file *file, const char __user *buf,
+			     size_t count, loff_t *ppos)
+{
+	struct task_struct *task;
+	char buffer[64];
+	char *type_buf, *size_buf;
+	struct mm_struct *mm;
+	struct vm_area_struct *vma;
+	enum reclaim_type type;
+	struct reclaim_walk rw = {
+		.nr_to_reclaim = ULONG_MAX,
+	};
+	unsigned long long size;
+
+	memset(buffer, 0, sizeof(buffer));
+	if (count > sizeof(buffer) - 1)
+		count = sizeof(buffer) - 1;
+	if (copy_from_user(buffer, buf, count))
+		return -EFAULT;
+
+	/* "file", "anon" or "all", optionally followed by a size in bytes */
+	size_buf = strstrip(buffer);
+	type_buf = strsep(&size_buf, " \t");
+	if (!strcmp(type_buf, "file")) {
+		type = RECLAIM_FILE;
+	} else if (!strcmp(type_buf, "anon")) {
+		type = RECLAIM_ANON;
+	} else if (!strcmp(type_buf, "all")) {
+		type = RECLAIM_ALL;
+	} else if (isdigit(*type_buf)) {
+		type = RECLAIM_ALL;
+		size_buf = type_buf;
+	} else {
+		return -EINVAL;
+	}
+
+	if (size_buf) {
+		size_buf = skip_spaces(size_buf);
+		size = memparse(size_buf, &size_buf);
+		if (*size_buf || !size)
+			return -EINVAL;
+		size >>= PAGE_SHIFT;
+		rw.nr_to_reclaim = size ? min_t(unsigned long long, size,
+						ULONG_MAX) : 1;
+	}
+
+	task = get_proc_task(file->f_path.dentry->d_inode);
+	if (!task)
+		return -ESRCH;
+	mm = get_task_mm(task);
+	if (mm) {
+		struct mm_walk reclaim_walk = {
+			.pmd_entry = reclaim_pte_range,
+			.mm = mm,
+			.private = &rw,
+		};
+
+		/* Flush the pagevecs so that isolate_lru_page() finds them */
+		lru_add_drain_all();
+
+		down_read(&mm->mmap_sem);
+		for (vma = mm->mmap; vma; vma = vma->vm_next) {
+			if (is_vm_hugetlb_page(vma))
+				continue;
+			if (vma->vm_flags & VM_LOCKED)
+				continue;
+			if (type == RECLAIM_ANON && vma->vm_file)
+				continue;
+			if (type == RECLAIM_FILE && !vma->vm_file)
+				continue;
+			rw.vma = vma;
+			if (walk_page_range(vma->vm_start, vma->vm_end,
+					    &reclaim_walk))
+				break;
+		}
+		up_read(&mm->mmap_sem);
+		mmput(mm);
+	}
+	put_task_struct(task);
+
+	return count;
+}
+
+const struct file_operations proc_reclaim_operations = {
+	.write		= reclaim_write,
+	.llseek		= noop_llseek,
+};
+#endif /* CONFIG_PROCESS_RECLAIM */
+
 struct pagemapread {
 	int pos, len;
 	u64 *buffer;
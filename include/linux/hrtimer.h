@@ -102,6 +102,8 @@ enum hrtimer_restart {
  *		started the timer
  * @start_pid: timer statistics field to store the pid of the task which
  *		started the timer
+ * @saved_cpu:	timer statistics field to store the idle cpu the timer was
+ *		moved off when it was started, or -1
  *
  * The hrtimer structure must be initialized by hrtimer_init()
  */
@@ -115,6 +117,7 @@ struct hrtimer {
 	int				start_pid;
 	void				*start_site;
 	char				start_comm[16];
+	int				saved_cpu;
 #endif
 };
 
@@ -308,6 +311,8 @@ static inline int hrtimer_is_hres_active(struct hrtimer *timer)
 }
 #endif
 
+extern unsigned int sysctl_hrtimer_coalesce_ns;
+
 extern void clock_was_set(void);
 #ifdef CONFIG_TIMERFD
 extern void timerfd_clock_was_set(void);
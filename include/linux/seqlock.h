@@ -149,6 +149,23 @@ repeat:
 	return ret;
 }
 
+/**
+ * raw_read_seqcount - read the raw seqcount
+ * @s: pointer to seqcount_t
+ * Returns: count to be passed to read_seqcount_retry
+ *
+ * raw_read_seqcount opens a read critical section of the given seqcount
+ * without any lockdep checking and without checking or masking the
+ * sequence number; the caller has to check for an odd count itself.
+ */
+static inline unsigned raw_read_seqcount(const seqcount_t *s)
+{
+	unsigned ret = ACCESS_ONCE(s->sequence);
+
+	smp_rmb();
+	return ret;
+}
+
 /**
  * read_seqcount_begin - begin a seq-read critical section
  * @s: pointer to seqcount_t
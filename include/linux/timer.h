@@ -27,6 +27,7 @@ struct timer_list {
 	int start_pid;
 	void *start_site;
 	char start_comm[16];
+	int saved_cpu;		/* idle cpu it was moved off, or -1 */
 #endif
 #ifdef CONFIG_LOCKDEP
 	struct lockdep_map lockdep_map;
@@ -247,6 +248,9 @@ extern void timer_stats_update_stats(void *timer, pid_t pid, void *startf,
 extern void __timer_stats_timer_set_start_info(struct timer_list *timer,
 					       void *addr);
 
+extern void __timer_stats_account_migrated(int cpu);
+extern void __timer_stats_account_shared(void);
+
 static inline void timer_stats_timer_set_start_info(struct timer_list *timer)
 {
 	if (likely(!timer_stats_active))
@@ -258,6 +262,25 @@ static inline void timer_stats_timer_clear_start_info(struct timer_list *timer)
 {
 	timer->start_site = NULL;
 }
+
+/*
+ * Wakeups saved by moving a timer off idle @cpu, counted when it expires
+ * elsewhere, or of the local cpu by running a timer from the expiry of
+ * another one:
+ */
+static inline void timer_stats_account_migrated(int cpu)
+{
+	if (likely(!timer_stats_active))
+		return;
+	__timer_stats_account_migrated(cpu);
+}
+
+static inline void timer_stats_account_shared(void)
+{
+	if (likely(!timer_stats_active))
+		return;
+	__timer_stats_account_shared();
+}
 #else
 static inline void init_timer_stats(void)
 {
@@ -270,6 +293,14 @@ static inline void timer_stats_timer_set_start_info(struct timer_list *timer)
 static inline void timer_stats_timer_clear_start_info(struct timer_list *timer)
 {
 }
+
+static inline void timer_stats_account_migrated(int cpu)
+{
+}
+
+static inline void timer_stats_account_shared(void)
+{
+}
 #endif
 
 extern void add_timer(struct timer_list *timer);
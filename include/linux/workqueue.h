@@ -103,6 +103,20 @@ struct execute_work {
 	struct work_struct work;
 };
 
+struct batch_work;
+struct batch_work_cpu;
+typedef void (*batch_func_t)(struct batch_work *bw, struct list_head *items);
+
+/*
+ * A batch_work collects items (list_heads embedded in the caller's
+ * objects) on per-cpu lists and passes each list to ->func as a whole,
+ * from a single work item execution per burst.
+ */
+struct batch_work {
+	batch_func_t func;
+	struct batch_work_cpu __percpu *cpu;
+};
+
 #ifdef CONFIG_LOCKDEP
 /*
  * NB: because we have to copy the lockdep_map, setting _key
@@ -364,6 +378,14 @@ extern int schedule_delayed_work(struct delayed_work *work, unsigned long delay)
 extern int schedule_delayed_work_on(int cpu, struct delayed_work *work,
 					unsigned long delay);
 extern int schedule_on_each_cpu(work_func_t func);
+
+extern int init_batch_work(struct batch_work *bw, batch_func_t func);
+extern void destroy_batch_work(struct batch_work *bw);
+extern void batch_work_set_affinity(struct batch_work *bw, int cpu,
+				    int target);
+extern int queue_batch_item(struct workqueue_struct *wq, struct batch_work *bw,
+			    struct list_head *item);
+extern void flush_batch_work(struct batch_work *bw);
 extern int keventd_up(void);
 
 int execute_in_process_context(work_func_t fn, struct execute_work *);
@@ -59,6 +59,8 @@
 #include <linux/magic.h>
 #include <linux/pid.h>
 #include <linux/nsproxy.h>
+#include <linux/bootmem.h>
+#include <linux/log2.h>
 
 #include <asm/futex.h>
 
@@ -66,8 +68,6 @@
 
 int __read_mostly futex_cmpxchg_enabled;
 
-#define FUTEX_HASHBITS (CONFIG_BASE_SMALL ? 4 : 8)
-
 /*
  * Futex flags used to encode options to functions and preserve them across
  * restarts.
@@ -75,6 +75,7 @@ int __read_mostly futex_cmpxchg_enabled;
 #define FLAGS_SHARED		0x01
 #define FLAGS_CLOCKRT		0x02
 #define FLAGS_HAS_TIMEOUT	0x04
+#define FLAGS_SPIN		0x08
 
 /*
  * Priority Inheritance state:
@@ -145,9 +146,14 @@ static const struct futex_q futex_q_init = {
 struct futex_hash_bucket {
 	spinlock_t lock;
 	struct plist_head chain;
-};
+} ____cacheline_aligned_in_smp;
 
-static struct futex_hash_bucket futex_queues[1<<FUTEX_HASHBITS];
+/*
+ * The hash table is sized by the number of possible cpus, so that more
+ * cpus contending on more futexes do not end up in the same buckets:
+ */
+static unsigned long __read_mostly futex_hashsize;
+static struct futex_hash_bucket *futex_queues __read_mostly;
 
 /*
  * We hash on the keys returned from get_futex_key (see below).
@@ -157,7 +163,7 @@ static struct futex_hash_bucket *hash_futex(union futex_key *key)
 	u32 hash = jhash2((u32*)&key->both.word,
 			  (sizeof(key->both.word)+sizeof(key->both.ptr))/4,
 			  key->both.offset);
-	return &futex_queues[hash & ((1 << FUTEX_HASHBITS)-1)];
+	return &futex_queues[hash & (futex_hashsize - 1)];
 }
 
 /*
@@ -2002,6 +2008,63 @@ out:
 	return ret;
 }
 
+#ifdef CONFIG_SMP
+/*
+ * Upper bound on the time a waiter spins on the owner of a futex, the
+ * owner may well hold it for much longer than a sleep and wakeup take:
+ */
+#define FUTEX_SPIN_NS		(20 * NSEC_PER_USEC)
+
+/**
+ * futex_spin_on_owner() - Spin while the owner of a futex is running
+ * @uaddr:	the futex userspace address
+ * @val:	the expected value, holding the TID of the owner
+ *
+ * An owner running on another cpu is likely to release the futex before
+ * we could have gone to sleep and been woken up again.  Spin while it is
+ * running and the value does not change, unless somebody else wants our
+ * cpu.
+ *
+ * Returns:
+ *  1 - the futex value changed, the caller should not sleep
+ *  0 - the owner is not running, or we gave up spinning
+ */
+static int futex_spin_on_owner(u32 __user *uaddr, u32 val)
+{
+	struct task_struct *owner;
+	u64 stop;
+	u32 uval;
+	int ret = 0;
+
+	owner = futex_find_get_task(val & FUTEX_TID_MASK);
+	if (!owner)
+		return 0;
+
+	stop = local_clock() + FUTEX_SPIN_NS;
+	while (owner != current && task_curr(owner)) {
+		if (need_resched() || signal_pending(current))
+			break;
+		if (get_user(uval, uaddr))
+			break;
+		if (uval != val) {
+			ret = 1;
+			break;
+		}
+		if ((s64)(local_clock() - stop) > 0)
+			break;
+		cpu_relax();
+	}
+
+	put_task_struct(owner);
+	return ret;
+}
+#else
+static inline int futex_spin_on_owner(u32 __user *uaddr, u32 val)
+{
+	return 0;
+}
+#endif
+
 static int futex_wait(u32 __user *uaddr, unsigned int flags, u32 val,
 		      ktime_t *abs_time, u32 bitset)
 {
@@ -2015,6 +2078,9 @@ static int futex_wait(u32 __user *uaddr, unsigned int flags, u32 val,
 		return -EINVAL;
 	q.bitset = bitset;
 
+	if ((flags & FLAGS_SPIN) && futex_spin_on_owner(uaddr, val))
+		return -EWOULDBLOCK;
+
 	if (abs_time) {
 		to = &timeout;
 
@@ -2092,6 +2158,188 @@ static long futex_wait_restart(struct restart_block *restart)
 				restart->futex.val, tp, restart->futex.bitset);
 }
 
+/**
+ * futex_wait_multiple_setup() - Queue on all the futexes of a wait block
+ * @blocks:	the futexes and their expected values
+ * @qs:		the associated futex_qs, one per block
+ * @count:	number of blocks
+ * @flags:	futex flags (FLAGS_SHARED, etc.)
+ * @woken:	index of a futex we were woken on while backing out, or -1
+ *
+ * Like futex_wait_setup(), but every futex_q is queued as soon as the
+ * value of its futex has been checked, with the task already in
+ * TASK_INTERRUPTIBLE, so that a wakeup on any of them is not missed.  If
+ * a value does not match, the futex_qs queued so far are unqueued again;
+ * one of them may have been woken meanwhile, which is returned in @woken
+ * so that the wakeup is not lost.
+ *
+ * Returns:
+ *  0 - all the futex_qs are queued, the task is in TASK_INTERRUPTIBLE
+ * <0 - -EFAULT or -EWOULDBLOCK, nothing is queued and no q.key
+ *      reference is held
+ */
+static int futex_wait_multiple_setup(struct futex_wait_block *blocks,
+				     struct futex_q *qs, u32 count,
+				     unsigned int flags, int *woken)
+{
+	struct futex_hash_bucket *hb;
+	u32 uval;
+	int ret, i, j;
+
+	*woken = -1;
+retry:
+	for (i = 0; i < count; i++) {
+		ret = get_futex_key(blocks[i].uaddr, flags & FLAGS_SHARED,
+				    &qs[i].key, VERIFY_READ);
+		if (unlikely(ret != 0)) {
+			while (--i >= 0)
+				put_futex_key(&qs[i].key);
+			return ret;
+		}
+	}
+
+	set_current_state(TASK_INTERRUPTIBLE);
+
+	for (i = 0; i < count; i++) {
+		hb = queue_lock(&qs[i]);
+		ret = get_futex_value_locked(&uval, blocks[i].uaddr);
+		if (!ret && uval == blocks[i].val) {
+			queue_me(&qs[i], hb);
+			continue;
+		}
+		queue_unlock(&qs[i], hb);
+		__set_current_state(TASK_RUNNING);
+
+		for (j = 0; j < i; j++) {
+			if (!unqueue_me(&qs[j]) && *woken < 0)
+				*woken = j;
+		}
+		for (j = i; j < count; j++)
+			put_futex_key(&qs[j].key);
+
+		if (!ret)
+			return -EWOULDBLOCK;
+		if (*woken >= 0 || get_user(uval, blocks[i].uaddr))
+			return -EFAULT;
+		goto retry;
+	}
+
+	return 0;
+}
+
+/**
+ * futex_wait_multiple() - Wait on several futexes at once
+ * @ublocks:	userspace array of struct futex_wait_block
+ * @flags:	futex flags (FLAGS_SHARED, etc.)
+ * @count:	number of entries in @ublocks
+ * @abs_time:	absolute timeout, or NULL
+ *
+ * Sleep until woken on any of the futexes whose values match, like
+ * FUTEX_WAIT_BITSET does for a single one, so that event loops can wait
+ * on all their sources in one call.
+ *
+ * Returns:
+ * >=0 - the index of a futex we were woken on
+ *  <0 - -EWOULDBLOCK if a value did not match, -ETIMEDOUT, -EFAULT, ...
+ */
+static int futex_wait_multiple(struct futex_wait_block __user *ublocks,
+			       unsigned int flags, u32 count,
+			       ktime_t *abs_time)
+{
+	struct hrtimer_sleeper timeout, *to = NULL;
+	struct futex_wait_block *blocks;
+	struct futex_q *qs;
+	int ret, woken, i;
+
+	if (!count || count > FUTEX_WAIT_MULTIPLE_MAX)
+		return -EINVAL;
+
+	blocks = kmalloc(count * sizeof(*blocks), GFP_KERNEL);
+	qs = kmalloc(count * sizeof(*qs), GFP_KERNEL);
+	ret = -ENOMEM;
+	if (!blocks || !qs)
+		goto out_free;
+
+	ret = -EFAULT;
+	if (copy_from_user(blocks, ublocks, count * sizeof(*blocks)))
+		goto out_free;
+
+	ret = -EINVAL;
+	for (i = 0; i < count; i++) {
+		if (!blocks[i].bitset)
+			goto out_free;
+		qs[i] = futex_q_init;
+		qs[i].bitset = blocks[i].bitset;
+	}
+
+	if (abs_time) {
+		to = &timeout;
+
+		hrtimer_init_on_stack(&to->timer, CLOCK_MONOTONIC,
+				      HRTIMER_MODE_ABS);
+		hrtimer_init_sleeper(to, current);
+		hrtimer_set_expires_range_ns(&to->timer, *abs_time,
+					     current->timer_slack_ns);
+	}
+
+retry:
+	ret = futex_wait_multiple_setup(blocks, qs, count, flags, &woken);
+	if (ret) {
+		if (woken >= 0)
+			ret = woken;
+		goto out;
+	}
+
+	/* Arm the timer */
+	if (to) {
+		hrtimer_start_expires(&to->timer, HRTIMER_MODE_ABS);
+		if (!hrtimer_active(&to->timer))
+			to->task = NULL;
+	}
+
+	/* Don't sleep if we were removed from any of the hash lists */
+	for (i = 0; i < count; i++) {
+		if (plist_node_empty(&qs[i].list))
+			break;
+	}
+	if (i == count && (!to || to->task))
+		schedule();
+	__set_current_state(TASK_RUNNING);
+
+	/* unqueue_me() drops the q.key refs */
+	woken = -1;
+	for (i = 0; i < count; i++) {
+		if (!unqueue_me(&qs[i]) && woken < 0)
+			woken = i;
+	}
+	ret = woken;
+	if (woken >= 0)
+		goto out;
+	ret = -ETIMEDOUT;
+	if (to && !to->task)
+		goto out;
+
+	/* Spurious wakeup, see futex_wait() */
+	if (!signal_pending(current))
+		goto retry;
+
+	/*
+	 * A relative timeout was converted to an absolute one on entry, so
+	 * the syscall can't simply be restarted with it.
+	 */
+	ret = abs_time ? -EINTR : -ERESTARTSYS;
+
+out:
+	if (to) {
+		hrtimer_cancel(&to->timer);
+		destroy_hrtimer_on_stack(&to->timer);
+	}
+out_free:
+	kfree(qs);
+	kfree(blocks);
+	return ret;
+}
+
 
 /*
  * Userspace tried a 0 -> TID atomic transition of the futex value
@@ -2784,6 +3032,12 @@ long do_futex(u32 __user *uaddr, int op, u32 val, ktime_t *timeout,
 			return -ENOSYS;
 	}
 
+	if (op & FUTEX_SPIN_FLAG) {
+		flags |= FLAGS_SPIN;
+		if (cmd != FUTEX_WAIT && cmd != FUTEX_WAIT_BITSET)
+			return -ENOSYS;
+	}
+
 	switch (cmd) {
 	case FUTEX_WAIT:
 		val3 = FUTEX_BITSET_MATCH_ANY;
@@ -2824,6 +3078,10 @@ long do_futex(u32 __user *uaddr, int op, u32 val, ktime_t *timeout,
 	case FUTEX_CMP_REQUEUE_PI:
 		ret = futex_requeue(uaddr, flags, uaddr2, val, val2, &val3, 1);
 		break;
+	case FUTEX_WAIT_MULTIPLE:
+		ret = futex_wait_multiple((void __user *)uaddr, flags, val,
+					  timeout);
+		break;
 	default:
 		ret = -ENOSYS;
 	}
@@ -2842,14 +3100,15 @@ SYSCALL_DEFINE6(futex, u32 __user *, uaddr, int, op, u32, val,
 
 	if (utime && (cmd == FUTEX_WAIT || cmd == FUTEX_LOCK_PI ||
 		      cmd == FUTEX_WAIT_BITSET ||
-		      cmd == FUTEX_WAIT_REQUEUE_PI)) {
+		      cmd == FUTEX_WAIT_REQUEUE_PI ||
+		      cmd == FUTEX_WAIT_MULTIPLE)) {
 		if (copy_from_user(&ts, utime, sizeof(ts)) != 0)
 			return -EFAULT;
 		if (!timespec_valid(&ts))
 			return -EINVAL;
 
 		t = timespec_to_ktime(ts);
-		if (cmd == FUTEX_WAIT)
+		if (cmd == FUTEX_WAIT || cmd == FUTEX_WAIT_MULTIPLE)
 			t = ktime_add_safe(ktime_get(), t);
 		tp = &t;
 	}
@@ -2866,6 +3125,7 @@ SYSCALL_DEFINE6(futex, u32 __user *, uaddr, int, op, u32, val,
 
 static int __init futex_init(void)
 {
+	unsigned int futex_shift;
 	u32 curval;
 	int i;
 
@@ -2882,7 +3142,19 @@ static int __init futex_init(void)
 	if (cmpxchg_futex_value_locked(&curval, NULL, 0, 0) == -EFAULT)
 		futex_cmpxchg_enabled = 1;
 
-	for (i = 0; i < ARRAY_SIZE(futex_queues); i++) {
+#if CONFIG_BASE_SMALL
+	futex_hashsize = 16;
+#else
+	futex_hashsize = roundup_pow_of_two(256 * num_possible_cpus());
+#endif
+	/* The table may come back smaller than asked for, use its size */
+	futex_queues = alloc_large_system_hash("futex", sizeof(*futex_queues),
+					       futex_hashsize, 0, 0,
+					       &futex_shift, NULL,
+					       futex_hashsize);
+	futex_hashsize = 1UL << futex_shift;
+
+	for (i = 0; i < futex_hashsize; i++) {
 		plist_head_init(&futex_queues[i].chain);
 		spin_lock_init(&futex_queues[i].lock);
 	}
@@ -170,21 +170,32 @@ static int hrtimer_get_target(int this_cpu, int pinned)
  * before the next event on the target cpu because we cannot reprogram
  * the target cpu hardware and we would cause it to fire late.
  *
+ * Without it the timer is run from the tick of the target cpu, which
+ * is stopped when the target is idle (the housekeeping cpu may be).
+ *
  * Called with cpu_base->lock of target cpu held.
  */
 static int
-hrtimer_check_target(struct hrtimer *timer, struct hrtimer_clock_base *new_base)
+hrtimer_check_target(struct hrtimer *timer, struct hrtimer_clock_base *new_base,
+		     int cpu)
 {
 #ifdef CONFIG_HIGH_RES_TIMERS
 	ktime_t expires;
 
-	if (!new_base->cpu_base->hres_active)
-		return 0;
+	if (new_base->cpu_base->hres_active) {
+		expires = ktime_sub(hrtimer_get_expires(timer),
+				    new_base->offset);
+		return expires.tv64 <= new_base->cpu_base->expires_next.tv64;
+	}
+#endif
+	return idle_cpu(cpu);
+}
 
-	expires = ktime_sub(hrtimer_get_expires(timer), new_base->offset);
-	return expires.tv64 <= new_base->cpu_base->expires_next.tv64;
-#else
-	return 0;
+static inline void timer_stats_hrtimer_set_saved_cpu(struct hrtimer *timer,
+						     int cpu)
+{
+#ifdef CONFIG_TIMER_STATS
+	timer->saved_cpu = cpu;
 #endif
 }
 
@@ -201,6 +212,7 @@ switch_hrtimer_base(struct hrtimer *timer, struct hrtimer_clock_base *base,
 	int cpu = hrtimer_get_target(this_cpu, pinned);
 	int basenum = base->index;
 
+	timer_stats_hrtimer_set_saved_cpu(timer, -1);
 again:
 	new_cpu_base = &per_cpu(hrtimer_bases, cpu);
 	new_base = &new_cpu_base->clock_base[basenum];
@@ -223,7 +235,8 @@ again:
 		raw_spin_unlock(&base->cpu_base->lock);
 		raw_spin_lock(&new_base->cpu_base->lock);
 
-		if (cpu != this_cpu && hrtimer_check_target(timer, new_base)) {
+		if (cpu != this_cpu &&
+		    hrtimer_check_target(timer, new_base, cpu)) {
 			cpu = this_cpu;
 			raw_spin_unlock(&new_base->cpu_base->lock);
 			raw_spin_lock(&base->cpu_base->lock);
@@ -232,6 +245,9 @@ again:
 		}
 		timer->base = new_base;
 	}
+	/* Counted as a saved wakeup if it expires while this cpu sleeps */
+	if (cpu != this_cpu)
+		timer_stats_hrtimer_set_saved_cpu(timer, this_cpu);
 	return new_base;
 }
 
@@ -793,6 +809,8 @@ static inline void timer_stats_account_hrtimer(struct hrtimer *timer)
 		return;
 	timer_stats_update_stats(timer, timer->start_pid, timer->start_site,
 				 timer->function, timer->start_comm, 0);
+	if (timer->saved_cpu >= 0 && idle_cpu(timer->saved_cpu))
+		timer_stats_account_migrated(timer->saved_cpu);
 #endif
 }
 
@@ -941,6 +959,35 @@ remove_hrtimer(struct hrtimer *timer, struct hrtimer_clock_base *base)
 	return 0;
 }
 
+/*
+ * Grid for the hard expiry of timers with slack, 0 to disable:
+ */
+unsigned int sysctl_hrtimer_coalesce_ns = NSEC_PER_MSEC;
+
+/*
+ * Pull the hard expiry of a timer back to the last multiple of
+ * sysctl_hrtimer_coalesce_ns, if that still lies inside its slack.
+ * Timers with slack armed at different times, or on different cpus,
+ * then share expiries instead of each of them waking a cpu up.
+ */
+static inline void hrtimer_coalesce(struct hrtimer *timer)
+{
+	unsigned int grid = ACCESS_ONCE(sysctl_hrtimer_coalesce_ns);
+	s64 soft, hard, aligned;
+
+	if (!grid)
+		return;
+
+	soft = ktime_to_ns(hrtimer_get_softexpires(timer));
+	hard = ktime_to_ns(hrtimer_get_expires(timer));
+	if (hard <= soft)
+		return;
+
+	aligned = ktime_divns(hrtimer_get_expires(timer), grid) * grid;
+	if (aligned >= soft && aligned < hard)
+		timer->node.expires = ns_to_ktime(aligned);
+}
+
 int __hrtimer_start_range_ns(struct hrtimer *timer, ktime_t tim,
 		unsigned long delta_ns, const enum hrtimer_mode mode,
 		int wakeup)
@@ -972,6 +1019,7 @@ int __hrtimer_start_range_ns(struct hrtimer *timer, ktime_t tim,
 	}
 
 	hrtimer_set_expires_range_ns(timer, tim, delta_ns);
+	hrtimer_coalesce(timer);
 
 	timer_stats_hrtimer_set_start_info(timer);
 
@@ -1155,6 +1203,7 @@ static void __hrtimer_init(struct hrtimer *timer, clockid_t clock_id,
 	timer->start_site = NULL;
 	timer->start_pid = -1;
 	memset(timer->start_comm, 0, TASK_COMM_LEN);
+	timer->saved_cpu = -1;
 #endif
 }
 
@@ -1301,6 +1350,10 @@ retry:
 				break;
 			}
 
+			/* Run from the expiry of another timer */
+			if (basenow.tv64 < hrtimer_get_expires_tv64(timer))
+				timer_stats_account_shared();
+
 			__run_hrtimer(timer, &basenow);
 		}
 	}
@@ -41,6 +41,7 @@
 #include <linux/cpu.h>
 #include <linux/notifier.h>
 #include <linux/rculist.h>
+#include <linux/kthread.h>
 
 #include <asm/uaccess.h>
 
@@ -146,6 +147,14 @@ EXPORT_SYMBOL(console_set_on_cmdline);
 /* Flag: console code may call schedule() */
 static int console_may_schedule;
 
+/*
+ * Work for printk_tick(): wake up klogd, or the printk drain thread.
+ */
+#define PRINTK_PENDING_WAKEUP	0x01
+#define PRINTK_PENDING_STAGE	0x02
+
+static DEFINE_PER_CPU(int, printk_pending);
+
 #ifdef CONFIG_PRINTK
 
 static char __log_buf[__LOG_BUF_LEN];
@@ -878,61 +887,19 @@ static inline void printk_delay(void)
 	}
 }
 
-asmlinkage int vprintk(const char *fmt, va_list args)
+/*
+ * Copy a message to log_buf, adding the log level and the time stamp 't'
+ * at the start of every line.  Returns the number of characters added.
+ * Called with logbuf_lock held.
+ */
+static int log_emit(const char *text, unsigned long long t)
 {
-	int printed_len = 0;
 	int current_log_level = default_message_loglevel;
-	unsigned long flags;
-	int this_cpu;
-	char *p;
+	int added = 0;
+	const char *p = text;
 	size_t plen;
 	char special;
 
-	boot_delay_msec();
-	printk_delay();
-
-	preempt_disable();
-	/* This stops the holder of console_sem just where we want him */
-	raw_local_irq_save(flags);
-	this_cpu = smp_processor_id();
-
-	/*
-	 * Ouch, printk recursed into itself!
-	 */
-	if (unlikely(printk_cpu == this_cpu)) {
-		/*
-		 * If a crash is occurring during printk() on this CPU,
-		 * then try to get the crash message out but make sure
-		 * we can't deadlock. Otherwise just return to avoid the
-		 * recursion and return - but flag the recursion so that
-		 * it can be printed at the next appropriate moment:
-		 */
-		if (!oops_in_progress) {
-			recursion_bug = 1;
-			goto out_restore_irqs;
-		}
-		zap_locks();
-	}
-
-	lockdep_off();
-	spin_lock(&logbuf_lock);
-	printk_cpu = this_cpu;
-
-	if (recursion_bug) {
-		recursion_bug = 0;
-		strcpy(printk_buf, recursion_bug_msg);
-		printed_len = strlen(recursion_bug_msg);
-	}
-	/* Emit the output into the temporary buffer */
-	printed_len += vscnprintf(printk_buf + printed_len,
-				  sizeof(printk_buf) - printed_len, fmt, args);
-
-#ifdef	CONFIG_DEBUG_LL
-	printascii(printk_buf);
-#endif
-
-	p = printk_buf;
-
 	/* Read log level and handle special printk prefix */
 	plen = log_prefix(p, &current_log_level, &special);
 	if (plen) {
@@ -965,32 +932,31 @@ asmlinkage int vprintk(const char *fmt, va_list args)
 				int i;
 
 				for (i = 0; i < plen; i++)
-					emit_log_char(printk_buf[i]);
-				printed_len += plen;
+					emit_log_char(text[i]);
+				added += plen;
 			} else {
 				/* Add log prefix */
 				emit_log_char('<');
 				emit_log_char(current_log_level + '0');
 				emit_log_char('>');
-				printed_len += 3;
+				added += 3;
 			}
 
 			if (printk_time) {
-				/* Add the current time stamp */
+				/* Add the time stamp */
 				char tbuf[50], *tp;
 				unsigned tlen;
-				unsigned long long t;
+				unsigned long long ts = t;
 				unsigned long nanosec_rem;
 
-				t = cpu_clock(printk_cpu);
-				nanosec_rem = do_div(t, 1000000000);
+				nanosec_rem = do_div(ts, 1000000000);
 				tlen = sprintf(tbuf, "[%5lu.%06lu] ",
-						(unsigned long) t,
+						(unsigned long) ts,
 						nanosec_rem / 1000);
 
 				for (tp = tbuf; tp < tbuf + tlen; tp++)
 					emit_log_char(*tp);
-				printed_len += tlen;
+				added += tlen;
 			}
 
 			if (!*p)
@@ -1002,6 +968,322 @@ asmlinkage int vprintk(const char *fmt, va_list args)
 			new_text_line = 1;
 	}
 
+	return added;
+}
+
+#ifdef CONFIG_PRINTK_DEFERRED
+/*
+ * printk() stages messages in a ring of the local cpu, without taking
+ * logbuf_lock or calling the console drivers, and printk_drain_thread()
+ * moves them to log_buf and the consoles later.  Each record is a struct
+ * stage_hdr followed by the text.  A ring is only written by its own cpu
+ * with interrupts disabled, and only read with logbuf_lock held.
+ *
+ * Messages that don't end a line, and the ones continuing them, go to
+ * log_buf directly instead: the drain orders records of different cpus by
+ * time, and would otherwise put other cpus' lines inside a partial one.
+ *
+ * While an oops is in progress, or the system is going down, printk()
+ * takes logbuf_lock and calls the consoles itself as usual, after moving
+ * all the staged messages to log_buf.
+ */
+#define PRINTK_STAGE_LEN	4096	/* power of two */
+
+struct stage_hdr {
+	u64		ts;
+	unsigned int	len;
+};
+
+struct printk_stage {
+	unsigned int	head;		/* written by the owning cpu */
+	unsigned int	tail;		/* written with logbuf_lock held */
+	int		busy;		/* the owning cpu is staging */
+	int		cont;		/* its last line is still partial */
+	char		text[1024];
+	char		buf[PRINTK_STAGE_LEN];
+};
+
+static DEFINE_PER_CPU(struct printk_stage, printk_stage);
+static struct task_struct *printk_drain_task;
+
+static int printk_deferred = 1;
+module_param_named(deferred, printk_deferred, bool, S_IRUGO | S_IWUSR);
+
+static void stage_write(struct printk_stage *s, unsigned int pos,
+			const void *src, unsigned int len)
+{
+	unsigned int off = pos & (PRINTK_STAGE_LEN - 1);
+	unsigned int n = min(len, PRINTK_STAGE_LEN - off);
+
+	memcpy(s->buf + off, src, n);
+	memcpy(s->buf, src + n, len - n);
+}
+
+static void stage_read(struct printk_stage *s, unsigned int pos,
+		       void *dst, unsigned int len)
+{
+	unsigned int off = pos & (PRINTK_STAGE_LEN - 1);
+	unsigned int n = min(len, PRINTK_STAGE_LEN - off);
+
+	memcpy(dst, s->buf + off, n);
+	memcpy(dst + n, s->buf, len - n);
+}
+
+static inline int printk_stage_enabled(void)
+{
+	return printk_deferred && printk_drain_task && !oops_in_progress &&
+	       system_state == SYSTEM_RUNNING;
+}
+
+/*
+ * Stage a message on this cpu.  Returns its length, or -1 if it has to
+ * go to log_buf directly because it is part of a partial line, the ring
+ * is full or we interrupted the staging of another message.  *@cont is
+ * set if it continues a partial line already in log_buf, which nothing
+ * else must be put in front of.  Called with interrupts disabled.
+ */
+static int vprintk_stage(const char *fmt, va_list args, int *cont)
+{
+	struct printk_stage *s = &__get_cpu_var(printk_stage);
+	struct stage_hdr hdr;
+	unsigned int head;
+	int ret = -1;
+
+	*cont = 0;
+	if (s->busy)
+		return -1;
+	s->busy = 1;
+
+	hdr.ts = cpu_clock(smp_processor_id());
+	hdr.len = vscnprintf(s->text, sizeof(s->text), fmt, args);
+
+	if (hdr.len && (s->cont || s->text[hdr.len - 1] != '\n')) {
+		*cont = s->cont;
+		s->cont = s->text[hdr.len - 1] != '\n';
+		goto out;
+	}
+
+	head = s->head;
+	if (head + sizeof(hdr) + hdr.len - ACCESS_ONCE(s->tail) <=
+	    PRINTK_STAGE_LEN) {
+		/* Don't overwrite what printk_stage_drain() still reads */
+		smp_mb();
+		stage_write(s, head, &hdr, sizeof(hdr));
+		stage_write(s, head + sizeof(hdr), s->text, hdr.len);
+		/* Make the record visible before the new head */
+		smp_wmb();
+		s->head = head + sizeof(hdr) + hdr.len;
+		__this_cpu_or(printk_pending, PRINTK_PENDING_STAGE);
+#ifdef	CONFIG_DEBUG_LL
+		printascii(s->text);
+#endif
+		ret = hdr.len;
+	}
+
+out:
+	s->busy = 0;
+	return ret;
+}
+
+/*
+ * Move the staged messages of all cpus to log_buf, oldest first.  Stops
+ * after a ring's worth per cpu, so that a printk storm can't keep us
+ * here with interrupts disabled.  Called with logbuf_lock held.
+ */
+static void printk_stage_drain(void)
+{
+	struct printk_stage *s, *first;
+	struct stage_hdr hdr, first_hdr;
+	unsigned long budget = num_possible_cpus() * PRINTK_STAGE_LEN;
+	int cpu;
+
+	while (budget) {
+		first = NULL;
+		for_each_possible_cpu(cpu) {
+			s = &per_cpu(printk_stage, cpu);
+			if (s->tail == ACCESS_ONCE(s->head))
+				continue;
+			/* Read the record only after seeing the head */
+			smp_rmb();
+			stage_read(s, s->tail, &hdr, sizeof(hdr));
+			if (!first || hdr.ts < first_hdr.ts) {
+				first = s;
+				first_hdr = hdr;
+			}
+		}
+		if (!first)
+			break;
+
+		stage_read(first, first->tail + sizeof(hdr), printk_buf,
+			   first_hdr.len);
+		printk_buf[first_hdr.len] = '\0';
+		/* Finish reading before the space can be reused */
+		smp_mb();
+		first->tail += sizeof(hdr) + first_hdr.len;
+		budget -= min_t(unsigned long, budget,
+				sizeof(hdr) + first_hdr.len);
+
+		log_emit(printk_buf, first_hdr.ts);
+	}
+}
+
+static int printk_stage_pending(void)
+{
+	struct printk_stage *s;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		s = &per_cpu(printk_stage, cpu);
+		if (s->tail != ACCESS_ONCE(s->head))
+			return 1;
+	}
+	return 0;
+}
+
+/*
+ * Woken from printk_tick() after messages were staged: move them to
+ * log_buf and print them, in process context.
+ */
+static int printk_drain_thread(void *unused)
+{
+	unsigned long flags;
+
+	while (!kthread_should_stop()) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (!printk_stage_pending())
+			schedule();
+		__set_current_state(TASK_RUNNING);
+
+		spin_lock_irqsave(&logbuf_lock, flags);
+		printk_stage_drain();
+		spin_unlock_irqrestore(&logbuf_lock, flags);
+
+		console_lock();
+		console_unlock();
+	}
+
+	return 0;
+}
+
+static int __init printk_drain_init(void)
+{
+	struct task_struct *p;
+
+	p = kthread_run(printk_drain_thread, NULL, "printkd");
+	if (IS_ERR(p))
+		return PTR_ERR(p);
+	printk_drain_task = p;
+	return 0;
+}
+early_initcall(printk_drain_init);
+
+static void printk_drain_wakeup(void)
+{
+	if (printk_drain_task)
+		wake_up_process(printk_drain_task);
+}
+#else
+static inline int printk_stage_enabled(void)
+{
+	return 0;
+}
+
+static inline int vprintk_stage(const char *fmt, va_list args, int *cont)
+{
+	*cont = 0;
+	return -1;
+}
+
+static inline void printk_stage_drain(void)
+{
+}
+
+static inline void printk_drain_wakeup(void)
+{
+}
+#endif /* CONFIG_PRINTK_DEFERRED */
+
+asmlinkage int vprintk(const char *fmt, va_list args)
+{
+	int printed_len = 0;
+	unsigned long flags;
+	int this_cpu;
+	int defer_console = 0, cont = 0;
+	va_list ap;
+
+	boot_delay_msec();
+	printk_delay();
+
+	preempt_disable();
+	/* This stops the holder of console_sem just where we want him */
+	raw_local_irq_save(flags);
+	this_cpu = smp_processor_id();
+
+	if (printk_stage_enabled()) {
+		va_copy(ap, args);
+		printed_len = vprintk_stage(fmt, ap, &cont);
+		va_end(ap);
+		if (printed_len >= 0)
+			goto out_restore_irqs;
+		printed_len = 0;
+		defer_console = 1;
+	}
+
+	/*
+	 * Ouch, printk recursed into itself!
+	 */
+	if (unlikely(printk_cpu == this_cpu)) {
+		/*
+		 * If a crash is occurring during printk() on this CPU,
+		 * then try to get the crash message out but make sure
+		 * we can't deadlock. Otherwise just return to avoid the
+		 * recursion and return - but flag the recursion so that
+		 * it can be printed at the next appropriate moment:
+		 */
+		if (!oops_in_progress) {
+			recursion_bug = 1;
+			goto out_restore_irqs;
+		}
+		zap_locks();
+	}
+
+	lockdep_off();
+	spin_lock(&logbuf_lock);
+	printk_cpu = this_cpu;
+
+	/*
+	 * Keep the messages staged earlier ahead of this one, unless it
+	 * continues a line this cpu has started in log_buf.
+	 */
+	if (!cont)
+		printk_stage_drain();
+
+	if (recursion_bug) {
+		recursion_bug = 0;
+		strcpy(printk_buf, recursion_bug_msg);
+		printed_len = strlen(recursion_bug_msg);
+	}
+	/* Emit the output into the temporary buffer */
+	printed_len += vscnprintf(printk_buf + printed_len,
+				  sizeof(printk_buf) - printed_len, fmt, args);
+
+#ifdef	CONFIG_DEBUG_LL
+	printascii(printk_buf);
+#endif
+
+	printed_len += log_emit(printk_buf, cpu_clock(printk_cpu));
+
+	/*
+	 * The stage overflowed: the message is in log_buf now, but the
+	 * consoles are still left to the drain thread.
+	 */
+	if (defer_console) {
+		printk_cpu = UINT_MAX;
+		spin_unlock(&logbuf_lock);
+		__this_cpu_or(printk_pending, PRINTK_PENDING_STAGE);
+		goto out_lockdep;
+	}
+
 	/*
 	 * Try to acquire and then immediately release the
 	 * console semaphore. The release will do all the
@@ -1015,6 +1297,7 @@ asmlinkage int vprintk(const char *fmt, va_list args)
 	if (console_trylock_for_printk(this_cpu))
 		console_unlock();
 
+out_lockdep:
 	lockdep_on();
 out_restore_irqs:
 	raw_local_irq_restore(flags);
@@ -1031,6 +1314,10 @@ static void call_console_drivers(unsigned start, unsigned end)
 {
 }
 
+static inline void printk_drain_wakeup(void)
+{
+}
+
 #endif
 
 static int __add_preferred_console(char *name, int idx, char *options,
@@ -1259,13 +1546,15 @@ int is_console_locked(void)
 	return console_locked;
 }
 
-static DEFINE_PER_CPU(int, printk_pending);
-
 void printk_tick(void)
 {
 	if (__this_cpu_read(printk_pending)) {
-		__this_cpu_write(printk_pending, 0);
-		wake_up_interruptible(&log_wait);
+		int pending = __this_cpu_xchg(printk_pending, 0);
+
+		if (pending & PRINTK_PENDING_WAKEUP)
+			wake_up_interruptible(&log_wait);
+		if (pending & PRINTK_PENDING_STAGE)
+			printk_drain_wakeup();
 	}
 }
 
@@ -1279,7 +1568,7 @@ int printk_needs_cpu(int cpu)
 void wake_up_klogd(void)
 {
 	if (waitqueue_active(&log_wait))
-		this_cpu_write(printk_pending, 1);
+		this_cpu_or(printk_pending, PRINTK_PENDING_WAKEUP);
 }
 
 /**
@@ -0,0 +1,138 @@
+/*
+ *  linux/kernel/printk_stress.c
+ *
+ *  Keeps every online cpu logging at once for as long as the module is
+ *  loaded.  A thread on every online cpu prints a burst of messages at
+ *  KERN_INFO, which the consoles print with the default console_loglevel,
+ *  times each call and sleeps until its next burst.  The latencies seen by
+ *  each cpu are reported when the module is removed:
+ *
+ *	printk_stress: cpu 0: 120000 calls  avg 2113 ns  max 5802771 ns
+ *
+ *  Run it with printk.deferred set to 0 and to 1 to compare printing
+ *  from printk() with printing from the printkd thread, while the rest of
+ *  the system is loaded the way it would be in the field.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/moduleparam.h>
+#include <linux/kthread.h>
+#include <linux/sched.h>
+#include <linux/percpu.h>
+#include <linux/cpu.h>
+#include <linux/jiffies.h>
+#include <linux/math64.h>
+
+static unsigned int burst = 100;
+module_param(burst, uint, 0444);
+MODULE_PARM_DESC(burst, "messages printed by each thread at a time");
+
+static unsigned int interval = 100;
+module_param(interval, uint, 0444);
+MODULE_PARM_DESC(interval, "msecs each thread sleeps between bursts");
+
+static bool irqs_off;
+module_param(irqs_off, bool, 0444);
+MODULE_PARM_DESC(irqs_off, "call printk() with interrupts disabled");
+
+struct stress_thread {
+	struct task_struct *task;
+	u64		calls;
+	u64		sum;
+	u64		max;
+};
+
+static DEFINE_PER_CPU(struct stress_thread, stress_thread);
+
+static int stress_thread_fn(void *arg)
+{
+	struct stress_thread *st = arg;
+	unsigned long flags = 0;
+	unsigned int i;
+	u64 t;
+
+	while (!kthread_should_stop()) {
+		for (i = 0; i < burst; i++) {
+			if (irqs_off)
+				local_irq_save(flags);
+			t = local_clock();
+			printk(KERN_INFO "printk_stress: cpu %d message %llu\n",
+			       raw_smp_processor_id(),
+			       (unsigned long long)st->calls);
+			t = local_clock() - t;
+			if (irqs_off)
+				local_irq_restore(flags);
+
+			st->calls++;
+			st->sum += t;
+			if (t > st->max)
+				st->max = t;
+		}
+		schedule_timeout_interruptible(msecs_to_jiffies(interval));
+	}
+
+	return 0;
+}
+
+static void __exit printk_stress_exit(void)
+{
+	struct stress_thread *st;
+	u64 avg;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		st = &per_cpu(stress_thread, cpu);
+		if (!st->task)
+			continue;
+		kthread_stop(st->task);
+		if (!st->calls)
+			continue;
+
+		avg = div64_u64(st->sum, st->calls);
+		printk(KERN_INFO "printk_stress: cpu %d: %llu calls  "
+		       "avg %llu ns  max %llu ns%s\n", cpu,
+		       (unsigned long long)st->calls, (unsigned long long)avg,
+		       (unsigned long long)st->max,
+		       irqs_off ? " (irqs off)" : "");
+	}
+}
+
+static int __init printk_stress_init(void)
+{
+	struct stress_thread *st;
+	struct task_struct *p;
+	int cpu, nr = 0;
+
+	if (!burst)
+		burst = 1;
+
+	get_online_cpus();
+	for_each_online_cpu(cpu) {
+		st = &per_cpu(stress_thread, cpu);
+		memset(st, 0, sizeof(*st));
+		p = kthread_create(stress_thread_fn, st, "printk_stress/%d",
+				   cpu);
+		if (IS_ERR(p))
+			continue;
+		kthread_bind(p, cpu);
+		st->task = p;
+		wake_up_process(p);
+		nr++;
+	}
+	put_online_cpus();
+
+	if (!nr)
+		return -ENOMEM;
+	return 0;
+}
+
+module_init(printk_stress_init);
+module_exit(printk_stress_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Stress test of printk latency");
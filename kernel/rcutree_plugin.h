@@ -64,7 +64,7 @@ static void __init rcu_bootup_announce_oddness(void)
 
 #ifdef CONFIG_TREE_PREEMPT_RCU
 
-struct rcu_state rcu_preempt_state = RCU_STATE_INITIALIZER(rcu_preempt_state);
+struct rcu_state rcu_preempt_state = RCU_STATE_INITIALIZER(rcu_preempt_state, 'p');
 DEFINE_PER_CPU(struct rcu_data, rcu_preempt_data);
 static struct rcu_state *rcu_state = &rcu_preempt_state;
 
@@ -639,7 +639,7 @@ static void rcu_preempt_do_callbacks(void)
  */
 void call_rcu(struct rcu_head *head, void (*func)(struct rcu_head *rcu))
 {
-	__call_rcu(head, func, &rcu_preempt_state);
+	__call_rcu(head, func, &rcu_preempt_state, true);
 }
 EXPORT_SYMBOL_GPL(call_rcu);
 
@@ -2008,3 +2008,238 @@ static void rcu_needs_cpu_flush(void)
 }
 
 #endif /* #else #if !defined(CONFIG_RCU_FAST_NO_HZ) */
+
+#ifdef CONFIG_RCU_NOCB_CPU
+
+/*
+ * Offload callback processing from the CPUs given by the "rcu_nocbs="
+ * boot parameter.  call_rcu() and friends on such a CPU append the
+ * callback to a lockless per-CPU, per-flavor queue and wake that
+ * queue's rcuo kthread when the queue was empty.  The kthread takes
+ * the whole queue, waits for a grace period to elapse, and invokes the
+ * callbacks it took, in order.  The offloaded CPU still takes part in
+ * grace periods, but it never needs the RCU softirq to invoke its
+ * callbacks, so callback invocation neither interrupts what runs there
+ * nor keeps it out of dyntick-idle mode.
+ *
+ * The rcuo kthreads start out confined to the CPUs that are not
+ * offloaded, CPU 0 being one of them.
+ */
+
+static cpumask_var_t rcu_nocb_mask;
+static bool have_rcu_nocb_mask;
+
+static int __init rcu_nocb_setup(char *str)
+{
+	alloc_bootmem_cpumask_var(&rcu_nocb_mask);
+	cpulist_parse(str, rcu_nocb_mask);
+	if (cpumask_test_cpu(0, rcu_nocb_mask)) {
+		printk(KERN_INFO "RCU: CPU 0 keeps its callbacks.\n");
+		cpumask_clear_cpu(0, rcu_nocb_mask);
+	}
+	cpumask_and(rcu_nocb_mask, rcu_nocb_mask, cpu_possible_mask);
+	have_rcu_nocb_mask = !cpumask_empty(rcu_nocb_mask);
+	return 1;
+}
+__setup("rcu_nocbs=", rcu_nocb_setup);
+
+/* Is the specified CPU a callback-offloaded CPU? */
+static bool is_nocb_cpu(int cpu)
+{
+	if (have_rcu_nocb_mask)
+		return cpumask_test_cpu(cpu, rcu_nocb_mask);
+	return false;
+}
+
+/*
+ * Append a callback to the specified CPU's offload queue.  This can be
+ * called from any CPU: the queue's tail is claimed with xchg(), and
+ * the kthread copes with a claimed but not yet linked-in ->next pointer.
+ */
+static void __call_rcu_nocb_enqueue(struct rcu_data *rdp,
+				    struct rcu_head *rhp)
+{
+	struct rcu_head **old_rhpp;
+
+	old_rhpp = xchg(&rdp->nocb_tail, &rhp->next);
+	ACCESS_ONCE(*old_rhpp) = rhp;
+	atomic_long_inc(&rdp->nocb_q_count);
+
+	/* Only the first callback of a batch needs to wake the kthread. */
+	if (old_rhpp == &rdp->nocb_head && ACCESS_ONCE(rdp->nocb_kthread)) {
+		atomic_long_inc(&rdp->n_nocb_wakeups);
+		wake_up(&rdp->nocb_wq);
+	}
+}
+
+/*
+ * Called from __call_rcu() with irqs disabled.  Returns true if the
+ * callback was handed to the CPU's rcuo kthread.
+ */
+static bool __call_rcu_nocb(struct rcu_data *rdp, struct rcu_head *rhp)
+{
+	if (!is_nocb_cpu(rdp->cpu))
+		return false;
+	__call_rcu_nocb_enqueue(rdp, rhp);
+	return true;
+}
+
+/*
+ * Queue an rcu_barrier() callback on every offloaded CPU, online or
+ * not: an offloaded CPU going offline leaves its callbacks with its
+ * kthread.  Each queue is FIFO, so the barrier callback is invoked
+ * after every callback queued on that CPU before it.  Called with
+ * rcu_barrier_mutex held.
+ */
+static void rcu_nocb_barrier(struct rcu_state *rsp)
+{
+	int cpu;
+
+	if (!have_rcu_nocb_mask)
+		return;
+	for_each_cpu(cpu, rcu_nocb_mask) {
+		atomic_inc(&rcu_barrier_cpu_count);
+		__call_rcu_nocb_enqueue(per_cpu_ptr(rsp->rda, cpu),
+					&per_cpu(rcu_barrier_head, cpu));
+	}
+}
+
+/*
+ * Wait for a grace period of the specified flavor.  The callback that
+ * ends the wait goes onto the normal callback list of whatever CPU the
+ * kthread happens to be running on, even an offloaded one, so that no
+ * rcuo kthread ever waits on a queue that an rcuo kthread must drain.
+ */
+static void rcu_nocb_wait_gp(struct rcu_state *rsp)
+{
+	struct rcu_synchronize rcu;
+
+	init_rcu_head_on_stack(&rcu.head);
+	init_completion(&rcu.completion);
+	__call_rcu(&rcu.head, wakeme_after_rcu, rsp, false);
+	wait_for_completion(&rcu.completion);
+	destroy_rcu_head_on_stack(&rcu.head);
+}
+
+/*
+ * Per-CPU, per-flavor kthread that invokes an offloaded CPU's callbacks.
+ */
+static int rcu_nocb_kthread(void *arg)
+{
+	struct rcu_data *rdp = arg;
+	struct rcu_head *list, *next, **tail;
+	long c;
+
+	for (;;) {
+		wait_event_interruptible(rdp->nocb_wq, rdp->nocb_head);
+		list = ACCESS_ONCE(rdp->nocb_head);
+		if (!list)
+			continue;
+
+		/* Take the whole queue; later callbacks start a new one. */
+		ACCESS_ONCE(rdp->nocb_head) = NULL;
+		tail = xchg(&rdp->nocb_tail, &rdp->nocb_head);
+		c = atomic_long_xchg(&rdp->nocb_q_count, 0);
+		ACCESS_ONCE(rdp->nocb_p_count) += c;
+
+		rcu_nocb_wait_gp(rdp->rsp);
+		rdp->n_nocb_batches++;
+
+		c = 0;
+		while (list) {
+			next = list->next;
+			/* Wait for an enqueue that claimed ->next to finish. */
+			while (next == NULL && &list->next != tail) {
+				schedule_timeout_interruptible(1);
+				next = list->next;
+			}
+			debug_rcu_head_unqueue(list);
+			local_bh_disable();
+			__rcu_reclaim(list);
+			local_bh_enable();
+			list = next;
+			c++;
+			cond_resched();
+		}
+		ACCESS_ONCE(rdp->nocb_p_count) -= c;
+		rdp->n_cbs_invoked += c;
+	}
+	return 0;
+}
+
+static void __init rcu_boot_init_nocb_percpu_data(struct rcu_data *rdp,
+						  struct rcu_state *rsp)
+{
+	rdp->nocb_tail = &rdp->nocb_head;
+	init_waitqueue_head(&rdp->nocb_wq);
+	rdp->rsp = rsp;
+}
+
+static void __init rcu_spawn_nocb_kthreads(struct rcu_state *rsp,
+					   cpumask_var_t cm)
+{
+	struct rcu_data *rdp;
+	struct task_struct *t;
+	int cpu;
+
+	for_each_cpu(cpu, rcu_nocb_mask) {
+		rdp = per_cpu_ptr(rsp->rda, cpu);
+		t = kthread_create(rcu_nocb_kthread, rdp,
+				   "rcuo%c/%d", rsp->abbr, cpu);
+		if (IS_ERR(t)) {
+			printk(KERN_ERR "RCU: Can't create rcuo%c/%d, "
+			       "callbacks stay queued\n", rsp->abbr, cpu);
+			continue;
+		}
+		set_cpus_allowed_ptr(t, cm);
+		ACCESS_ONCE(rdp->nocb_kthread) = t;
+		/* Pick up whatever was queued before the kthread existed. */
+		wake_up_process(t);
+	}
+}
+
+static int __init rcu_spawn_nocb(void)
+{
+	cpumask_var_t cm;
+	char buf[64];
+
+	if (!have_rcu_nocb_mask)
+		return 0;
+	if (!zalloc_cpumask_var(&cm, GFP_KERNEL))
+		return -ENOMEM;
+	cpumask_andnot(cm, cpu_possible_mask, rcu_nocb_mask);
+
+	cpulist_scnprintf(buf, sizeof(buf), rcu_nocb_mask);
+	printk(KERN_INFO "RCU: Offloading callbacks from CPUs %s.\n", buf);
+	rcu_spawn_nocb_kthreads(&rcu_sched_state, cm);
+	rcu_spawn_nocb_kthreads(&rcu_bh_state, cm);
+#ifdef CONFIG_TREE_PREEMPT_RCU
+	rcu_spawn_nocb_kthreads(&rcu_preempt_state, cm);
+#endif /* #ifdef CONFIG_TREE_PREEMPT_RCU */
+	free_cpumask_var(cm);
+	return 0;
+}
+early_initcall(rcu_spawn_nocb);
+
+#else /* #ifdef CONFIG_RCU_NOCB_CPU */
+
+static bool is_nocb_cpu(int cpu)
+{
+	return false;
+}
+
+static bool __call_rcu_nocb(struct rcu_data *rdp, struct rcu_head *rhp)
+{
+	return false;
+}
+
+static void rcu_nocb_barrier(struct rcu_state *rsp)
+{
+}
+
+static void __init rcu_boot_init_nocb_percpu_data(struct rcu_data *rdp,
+						  struct rcu_state *rsp)
+{
+}
+
+#endif /* #else #ifdef CONFIG_RCU_NOCB_CPU */
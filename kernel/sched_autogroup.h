@@ -16,6 +16,9 @@ struct autogroup {
 static inline bool task_group_is_autogroup(struct task_group *tg);
 static inline struct task_group *
 autogroup_task_group(struct task_struct *p, struct task_group *tg);
+#if defined(CONFIG_SCHED_DEBUG) || defined(CONFIG_SCHED_LATENCY_HIST)
+static inline int autogroup_path(struct task_group *tg, char *buf, int buflen);
+#endif
 
 #else /* !CONFIG_SCHED_AUTOGROUP */
 
@@ -32,7 +35,7 @@ autogroup_task_group(struct task_struct *p, struct task_group *tg)
 	return tg;
 }
 
-#ifdef CONFIG_SCHED_DEBUG
+#if defined(CONFIG_SCHED_DEBUG) || defined(CONFIG_SCHED_LATENCY_HIST)
 static inline int autogroup_path(struct task_group *tg, char *buf, int buflen)
 {
 	return 0;
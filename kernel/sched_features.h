@@ -49,6 +49,13 @@ SCHED_FEAT(CACHE_HOT_BUDDY, 1)
  */
 SCHED_FEAT(ARCH_POWER, 0)
 
+/*
+ * Place waking tasks with low utilization on already busy cpus that
+ * have spare capacity, rather than on idle ones, so that idle cpus can
+ * stay in deep idle states.
+ */
+SCHED_FEAT(PACK_SMALL_TASKS, 0)
+
 SCHED_FEAT(HRTICK, 0)
 SCHED_FEAT(DOUBLE_TICK, 0)
 SCHED_FEAT(LB_BIAS, 1)
@@ -71,4 +78,12 @@ SCHED_FEAT(NONTASK_POWER, 1)
  */
 SCHED_FEAT(TTWU_QUEUE, 1)
 
+/*
+ * When going idle, first try to steal the single queued task that is
+ * cheapest to move from a nearby overloaded cpu, before the full
+ * load_balance() pass over each domain.  Off until measured on the
+ * platform; enable it through sched_features in debugfs.
+ */
+SCHED_FEAT(IDLE_STEAL, 0)
+
 SCHED_FEAT(FORCE_SD_OVERLAP, 0)
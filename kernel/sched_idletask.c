@@ -24,6 +24,7 @@ static struct task_struct *pick_next_task_idle(struct rq *rq)
 {
 	schedstat_inc(rq, sched_goidle);
 	calc_load_account_idle(rq);
+	idle_enter_fair(rq);
 	return rq->idle;
 }
 
@@ -42,6 +43,7 @@ dequeue_task_idle(struct rq *rq, struct task_struct *p, int flags)
 
 static void put_prev_task_idle(struct rq *rq, struct task_struct *prev)
 {
+	idle_exit_fair(rq);
 }
 
 static void task_tick_idle(struct rq *rq, struct task_struct *curr, int queued)
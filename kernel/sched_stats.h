@@ -4,7 +4,7 @@
  * bump this up when changing the output format or the meaning of an existing
  * format, so that tools can adapt (or abort)
  */
-#define SCHEDSTAT_VERSION 15
+#define SCHEDSTAT_VERSION 16
 
 static int show_schedstat(struct seq_file *seq, void *v)
 {
@@ -26,12 +26,14 @@ static int show_schedstat(struct seq_file *seq, void *v)
 
 		/* runqueue-specific stats */
 		seq_printf(seq,
-		    "cpu%d %u %u %u %u %u %u %llu %llu %lu",
+		    "cpu%d %u %u %u %u %u %u %llu %llu %lu %u %u %llu",
 		    cpu, rq->yld_count,
 		    rq->sched_switch, rq->sched_count, rq->sched_goidle,
 		    rq->ttwu_count, rq->ttwu_local,
 		    rq->rq_cpu_time,
-		    rq->rq_sched_info.run_delay, rq->rq_sched_info.pcount);
+		    rq->rq_sched_info.run_delay, rq->rq_sched_info.pcount,
+		    rq->idle_steal_count, rq->idle_steal_success,
+		    rq->idle_steal_cost);
 
 		seq_printf(seq, "\n");
 
@@ -258,6 +260,186 @@ sched_info_switch(struct task_struct *prev, struct task_struct *next)
 #define sched_info_switch(t, next)		do { } while (0)
 #endif /* CONFIG_SCHEDSTATS || CONFIG_TASK_DELAY_ACCT */
 
+#ifdef CONFIG_SCHED_LATENCY_HIST
+/*
+ * bump this up when changing the format of <debugfs>/sched_lat_hist
+ */
+#define SCHED_LAT_HIST_VERSION 1
+
+/*
+ * Stamp a waking fair task with the time it became runnable.  A task
+ * that is still on its cpu (a remote wakeup racing with it going to
+ * sleep) never waits, so it is not stamped.
+ *
+ * Expects runqueue lock to be held.
+ */
+static inline void sched_lat_hist_wakeup(struct rq *rq, struct task_struct *p)
+{
+	if (p->sched_class == &fair_sched_class && !task_running(rq, p))
+		p->se.statistics.lat_wakeup_start = rq->clock;
+}
+
+/*
+ * Called when 'se' is picked to run on cfs_rq: if it is a task that was
+ * stamped at wakeup, account the time it waited in the cpu's and its
+ * group's histograms.  Group entities are never stamped.
+ *
+ * Expects runqueue lock to be held.
+ */
+static inline void sched_lat_hist_run(struct rq *rq, struct cfs_rq *cfs_rq,
+				      struct sched_entity *se)
+{
+	u64 start = se->statistics.lat_wakeup_start;
+	s64 delta;
+	int bucket = 0;
+
+	if (!start)
+		return;
+	se->statistics.lat_wakeup_start = 0;
+
+	delta = rq->clock - start;
+	if (delta > 0)
+		bucket = fls64((u64)delta >> 10);
+	if (bucket >= SCHED_LAT_HIST_BUCKETS)
+		bucket = SCHED_LAT_HIST_BUCKETS - 1;
+
+	rq->lat_hist[bucket]++;
+	cfs_rq->lat_hist[bucket]++;
+}
+
+static void sched_lat_hist_print(struct seq_file *m, const char *name,
+				 unsigned int *hist)
+{
+	int i;
+
+	seq_printf(m, "%s", name);
+	for (i = 0; i < SCHED_LAT_HIST_BUCKETS; i++)
+		seq_printf(m, " %u", hist[i]);
+}
+
+/*
+ * One line per cpu, "cpu<N> <buckets>", then with group scheduling one
+ * line per task group, "group <buckets> <path>", with the counts of the
+ * group's cfs_rqs summed over all cpus.
+ */
+static int sched_lat_hist_show(struct seq_file *m, void *v)
+{
+	char name[16];
+	int cpu;
+#ifdef CONFIG_FAIR_GROUP_SCHED
+	unsigned int hist[SCHED_LAT_HIST_BUCKETS];
+	struct task_group *tg;
+	char *path;
+	int i;
+#endif
+
+	seq_printf(m, "version %d\n", SCHED_LAT_HIST_VERSION);
+	seq_printf(m, "buckets %d\n", SCHED_LAT_HIST_BUCKETS);
+
+	for_each_online_cpu(cpu) {
+		snprintf(name, sizeof(name), "cpu%d", cpu);
+		sched_lat_hist_print(m, name, cpu_rq(cpu)->lat_hist);
+		seq_printf(m, "\n");
+	}
+
+#ifdef CONFIG_FAIR_GROUP_SCHED
+	path = kmalloc(PATH_MAX, GFP_KERNEL);
+	if (!path)
+		return -ENOMEM;
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(tg, &task_groups, list) {
+		memset(hist, 0, sizeof(hist));
+		for_each_online_cpu(cpu) {
+			for (i = 0; i < SCHED_LAT_HIST_BUCKETS; i++)
+				hist[i] += tg->cfs_rq[cpu]->lat_hist[i];
+		}
+
+		if (!autogroup_path(tg, path, PATH_MAX)) {
+			/* May be NULL if the cgroup isn't fully created yet */
+			if (tg->css.cgroup)
+				cgroup_path(tg->css.cgroup, path, PATH_MAX);
+			else
+				strcpy(path, "/");
+		}
+
+		sched_lat_hist_print(m, "group", hist);
+		seq_printf(m, " %s\n", path);
+	}
+	rcu_read_unlock();
+
+	kfree(path);
+#endif
+	return 0;
+}
+
+static void sched_lat_hist_reset(void)
+{
+	struct rq *rq;
+	int cpu;
+#ifdef CONFIG_FAIR_GROUP_SCHED
+	struct task_group *tg;
+#endif
+
+	for_each_possible_cpu(cpu) {
+		rq = cpu_rq(cpu);
+
+		raw_spin_lock_irq(&rq->lock);
+		memset(rq->lat_hist, 0, sizeof(rq->lat_hist));
+#ifdef CONFIG_FAIR_GROUP_SCHED
+		rcu_read_lock();
+		list_for_each_entry_rcu(tg, &task_groups, list)
+			memset(tg->cfs_rq[cpu]->lat_hist, 0,
+			       sizeof(tg->cfs_rq[cpu]->lat_hist));
+		rcu_read_unlock();
+#else
+		memset(rq->cfs.lat_hist, 0, sizeof(rq->cfs.lat_hist));
+#endif
+		raw_spin_unlock_irq(&rq->lock);
+	}
+}
+
+static ssize_t sched_lat_hist_write(struct file *filp, const char __user *ubuf,
+				    size_t cnt, loff_t *ppos)
+{
+	sched_lat_hist_reset();
+	*ppos += cnt;
+
+	return cnt;
+}
+
+static int sched_lat_hist_open(struct inode *inode, struct file *filp)
+{
+	return single_open(filp, sched_lat_hist_show, NULL);
+}
+
+static const struct file_operations sched_lat_hist_fops = {
+	.open		= sched_lat_hist_open,
+	.write		= sched_lat_hist_write,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static __init int sched_lat_hist_init(void)
+{
+	debugfs_create_file("sched_lat_hist", 0644, NULL, NULL,
+			    &sched_lat_hist_fops);
+
+	return 0;
+}
+late_initcall(sched_lat_hist_init);
+
+#else
+static inline void sched_lat_hist_wakeup(struct rq *rq, struct task_struct *p)
+{
+}
+static inline void sched_lat_hist_run(struct rq *rq, struct cfs_rq *cfs_rq,
+				      struct sched_entity *se)
+{
+}
+#endif /* CONFIG_SCHED_LATENCY_HIST */
+
 /*
  * The following are functions that support scheduler-internal time accounting.
  * These functions are generally called at the timer tick.  None of this depends
@@ -135,12 +135,28 @@ static atomic_t overflow_count;
 
 static struct entry *tstat_hash_table[TSTAT_HASH_SIZE] __read_mostly;
 
+/*
+ * Wakeups saved per CPU, by timers moved off it while it was idle and
+ * by timers run early from the expiry of another timer:
+ */
+struct tstats_saved {
+	atomic_long_t		migrated;
+	unsigned long		shared;
+};
+
+static DEFINE_PER_CPU(struct tstats_saved, tstats_saved);
+
 static void reset_entries(void)
 {
+	int cpu;
+
 	nr_entries = 0;
 	memset(entries, 0, sizeof(entries));
 	memset(tstat_hash_table, 0, sizeof(tstat_hash_table));
 	atomic_set(&overflow_count, 0);
+	for_each_possible_cpu(cpu)
+		memset(&per_cpu(tstats_saved, cpu), 0,
+		       sizeof(struct tstats_saved));
 }
 
 static struct entry *alloc_entry(void)
@@ -267,6 +283,24 @@ void timer_stats_update_stats(void *timer, pid_t pid, void *startf,
 	raw_spin_unlock_irqrestore(lock, flags);
 }
 
+/*
+ * Called from the expiry of a timer that was moved off @cpu, on the CPU
+ * that ran it instead:
+ */
+void __timer_stats_account_migrated(int cpu)
+{
+	atomic_long_inc(&per_cpu(tstats_saved, cpu).migrated);
+}
+
+/*
+ * Called with irqs off, from the timer code of the CPU that was spared
+ * the wakeup:
+ */
+void __timer_stats_account_shared(void)
+{
+	__this_cpu_inc(tstats_saved.shared);
+}
+
 static void print_name_offset(struct seq_file *m, unsigned long addr)
 {
 	char symname[KSYM_NAME_LEN];
@@ -298,7 +332,7 @@ static int tstats_show(struct seq_file *m, void *v)
 	period = ktime_to_timespec(time);
 	ms = period.tv_nsec / 1000000;
 
-	seq_puts(m, "Timer Stats Version: v0.2\n");
+	seq_puts(m, "Timer Stats Version: v0.3\n");
 	seq_printf(m, "Sample period: %ld.%03ld s\n", period.tv_sec, ms);
 	if (atomic_read(&overflow_count))
 		seq_printf(m, "Overflow: %d entries\n",
@@ -333,6 +367,15 @@ static int tstats_show(struct seq_file *m, void *v)
 	else
 		seq_printf(m, "%ld total events\n", events);
 
+	for_each_online_cpu(i) {
+		struct tstats_saved *saved = &per_cpu(tstats_saved, i);
+		unsigned long migrated = atomic_long_read(&saved->migrated);
+
+		seq_printf(m, "Wakeups saved on cpu %d: %lu (%lu migrated "
+			   "%lu shared)\n", i, migrated + saved->shared,
+			   migrated, saved->shared);
+	}
+
 	mutex_unlock(&show_mutex);
 
 	return 0;
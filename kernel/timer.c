@@ -383,6 +383,12 @@ void __timer_stats_timer_set_start_info(struct timer_list *timer, void *addr)
 	timer->start_pid = current->pid;
 }
 
+static void timer_stats_timer_set_saved_cpu(struct timer_list *timer,
+					    int cpu)
+{
+	timer->saved_cpu = cpu;
+}
+
 static void timer_stats_account_timer(struct timer_list *timer)
 {
 	unsigned int flag = 0;
@@ -394,9 +400,15 @@ static void timer_stats_account_timer(struct timer_list *timer)
 
 	timer_stats_update_stats(timer, timer->start_pid, timer->start_site,
 				 timer->function, timer->start_comm, flag);
+
+	/* Once per expiry, and only if that cpu is still asleep */
+	if (timer->saved_cpu >= 0 && !flag && idle_cpu(timer->saved_cpu))
+		timer_stats_account_migrated(timer->saved_cpu);
 }
 
 #else
+static void timer_stats_timer_set_saved_cpu(struct timer_list *timer,
+					    int cpu) {}
 static void timer_stats_account_timer(struct timer_list *timer) {}
 #endif
 
@@ -563,6 +575,7 @@ static void __init_timer(struct timer_list *timer,
 	timer->start_site = NULL;
 	timer->start_pid = -1;
 	memset(timer->start_comm, 0, TASK_COMM_LEN);
+	timer->saved_cpu = -1;
 #endif
 	lockdep_init_map(&timer->lockdep_map, name, key, 0);
 }
@@ -653,6 +666,27 @@ static struct tvec_base *lock_timer_base(struct timer_list *timer,
 	}
 }
 
+/*
+ * A timer may be moved to the timer wheel of another cpu when that cpu
+ * is busy, or when it is idle (the housekeeping cpu may be) and the
+ * timer does not need to wake it before its next timer event anyway.
+ * Deferrable timers never wake a cpu up, so they can go anywhere.
+ *
+ * Called with the target base locked.
+ */
+static inline bool
+timer_target_ok(struct tvec_base *base, struct timer_list *timer,
+		unsigned long expires, int cpu)
+{
+	if (cpu == smp_processor_id() || !idle_cpu(cpu) ||
+	    tbase_get_deferrable(timer->base))
+		return true;
+
+	/* next_timer == timer_jiffies means it is not known */
+	return time_after(base->next_timer, base->timer_jiffies) &&
+	       !time_before(expires, base->next_timer);
+}
+
 static inline int
 __mod_timer(struct timer_list *timer, unsigned long expires,
 						bool pending_only, int pinned)
@@ -685,6 +719,7 @@ __mod_timer(struct timer_list *timer, unsigned long expires,
 	if (!pinned && get_sysctl_timer_migration() && idle_cpu(cpu))
 		cpu = get_nohz_timer_target();
 #endif
+again:
 	new_base = per_cpu(tvec_bases, cpu);
 
 	if (base != new_base) {
@@ -699,12 +734,26 @@ __mod_timer(struct timer_list *timer, unsigned long expires,
 			/* See the comment in lock_timer_base() */
 			timer_set_base(timer, NULL);
 			spin_unlock(&base->lock);
+			spin_lock(&new_base->lock);
+
+			if (!timer_target_ok(new_base, timer, expires, cpu)) {
+				cpu = smp_processor_id();
+				spin_unlock(&new_base->lock);
+				spin_lock(&base->lock);
+				timer_set_base(timer, base);
+				goto again;
+			}
 			base = new_base;
-			spin_lock(&base->lock);
 			timer_set_base(timer, base);
 		}
 	}
 
+	/* Counted as a saved wakeup if it expires while this cpu sleeps */
+	if (cpu != smp_processor_id() && base == new_base)
+		timer_stats_timer_set_saved_cpu(timer, smp_processor_id());
+	else
+		timer_stats_timer_set_saved_cpu(timer, -1);
+
 	timer->expires = expires;
 	if (time_before(timer->expires, base->next_timer) &&
 	    !tbase_get_deferrable(timer->base))
@@ -867,6 +916,7 @@ void add_timer_on(struct timer_list *timer, int cpu)
 	BUG_ON(timer_pending(timer) || !timer->function);
 	spin_lock_irqsave(&base->lock, flags);
 	timer_set_base(timer, base);
+	timer_stats_timer_set_saved_cpu(timer, -1);
 	debug_activate(timer, timer->expires);
 	if (time_before(timer->expires, base->next_timer) &&
 	    !tbase_get_deferrable(timer->base))
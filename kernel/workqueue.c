@@ -2882,6 +2882,165 @@ int execute_in_process_context(work_func_t fn, struct execute_work *ew)
 }
 EXPORT_SYMBOL_GPL(execute_in_process_context);
 
+/*
+ * Batch work.
+ *
+ * Items queued on a batch_work are appended to a per-cpu list and only
+ * the first item of a burst queues the work item that consumes the list,
+ * so a burst costs one insertion into the gcwq and at most one worker
+ * wakeup instead of one of each per item.  The work function takes the
+ * whole list and hands it to the batch function in one call.
+ *
+ * Items queued on a cpu are consumed on the cpu set with
+ * batch_work_set_affinity(), by default the producing cpu itself, so
+ * that the items are still cache hot when the consumer gets to them.
+ * The hint is only honoured by workqueues bound to cpus.
+ */
+struct batch_work_cpu {
+	spinlock_t		lock;
+	struct list_head	items;
+	struct work_struct	work;
+	struct batch_work	*bw;
+	int			target;	/* cpu consuming items queued here */
+};
+
+static void batch_work_fn(struct work_struct *work)
+{
+	struct batch_work_cpu *bwc =
+		container_of(work, struct batch_work_cpu, work);
+	LIST_HEAD(items);
+
+	spin_lock_irq(&bwc->lock);
+	list_splice_init(&bwc->items, &items);
+	spin_unlock_irq(&bwc->lock);
+
+	/* an item queued while we ran may have been taken by the last run */
+	if (!list_empty(&items))
+		bwc->bw->func(bwc->bw, &items);
+}
+
+/**
+ * init_batch_work - initialize a batch work
+ * @bw: the batch work to initialize
+ * @func: function called with each batch of items
+ *
+ * @func is called in process context with a list of the items queued
+ * since the previous call on the same cpu, in queueing order.  It owns
+ * the items and must remove them from the list before it returns.
+ *
+ * Returns 0 on success, -ENOMEM if the per-cpu state can't be allocated.
+ */
+int init_batch_work(struct batch_work *bw, batch_func_t func)
+{
+	int cpu;
+
+	bw->func = func;
+	bw->cpu = alloc_percpu(struct batch_work_cpu);
+	if (!bw->cpu)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		struct batch_work_cpu *bwc = per_cpu_ptr(bw->cpu, cpu);
+
+		spin_lock_init(&bwc->lock);
+		INIT_LIST_HEAD(&bwc->items);
+		INIT_WORK(&bwc->work, batch_work_fn);
+		bwc->bw = bw;
+		bwc->target = cpu;
+	}
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(init_batch_work);
+
+/**
+ * destroy_batch_work - release a batch work
+ * @bw: the batch work to release
+ *
+ * Waits for the queued items to be consumed.  The caller must make sure
+ * that no more items are queued on @bw.
+ */
+void destroy_batch_work(struct batch_work *bw)
+{
+	flush_batch_work(bw);
+	free_percpu(bw->cpu);
+	bw->cpu = NULL;
+}
+EXPORT_SYMBOL_GPL(destroy_batch_work);
+
+/**
+ * batch_work_set_affinity - set where the items queued on a cpu are consumed
+ * @bw: the batch work
+ * @cpu: the producing cpu
+ * @target: the cpu whose worker consumes the items queued on @cpu
+ *
+ * Pointing @cpu at a cpu that shares a cache with it lets the producer
+ * keep running while the items are consumed next door.  Items are
+ * consumed on the producing cpu while @target is offline.
+ */
+void batch_work_set_affinity(struct batch_work *bw, int cpu, int target)
+{
+	per_cpu_ptr(bw->cpu, cpu)->target = target;
+}
+EXPORT_SYMBOL_GPL(batch_work_set_affinity);
+
+/**
+ * queue_batch_item - queue an item on a batch work
+ * @wq: workqueue to use
+ * @bw: the batch work
+ * @item: list_head embedded in the object to hand to @bw's function
+ *
+ * Can be called from any context.
+ *
+ * Returns 0 if @item joined a batch that was already queued, non-zero
+ * if it started a new one.
+ */
+int queue_batch_item(struct workqueue_struct *wq, struct batch_work *bw,
+		     struct list_head *item)
+{
+	struct batch_work_cpu *bwc;
+	unsigned long flags;
+	int cpu, first;
+
+	local_irq_save(flags);
+	cpu = per_cpu_ptr(bw->cpu, smp_processor_id())->target;
+	if (unlikely(!cpu_online(cpu)))
+		cpu = smp_processor_id();
+	bwc = per_cpu_ptr(bw->cpu, cpu);
+
+	spin_lock(&bwc->lock);
+	first = list_empty(&bwc->items);
+	list_add_tail(item, &bwc->items);
+	spin_unlock(&bwc->lock);
+
+	/*
+	 * Racing with batch_work_fn() taking the list is fine: either it
+	 * sees our item or the list was empty and we queue another run.
+	 */
+	if (first)
+		queue_work_on(cpu, wq, &bwc->work);
+	local_irq_restore(flags);
+
+	return first;
+}
+EXPORT_SYMBOL_GPL(queue_batch_item);
+
+/**
+ * flush_batch_work - wait for the items queued on a batch work
+ * @bw: the batch work to flush
+ *
+ * Waits until every item queued on @bw before the call has been handed
+ * to its function and the function has returned.
+ */
+void flush_batch_work(struct batch_work *bw)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		flush_work_sync(&per_cpu_ptr(bw->cpu, cpu)->work);
+}
+EXPORT_SYMBOL_GPL(flush_batch_work);
+
 int keventd_up(void)
 {
 	return system_wq != NULL;
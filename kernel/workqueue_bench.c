@@ -0,0 +1,236 @@
+/*
+ *  linux/kernel/workqueue_bench.c
+ *
+ *  Compares queueing small items as one work item each with queueing
+ *  them on a batch_work.  A thread on every online cpu queues bursts of
+ *  items, yielding between bursts, first as work items and then as batch
+ *  items.  Writing to the run parameter starts a pass and logs
+ *
+ *	# echo 1 > /sys/module/workqueue_bench/parameters/run
+ *	workqueue_bench: single:  412345 items/s  0.412 wakeups/item
+ *	workqueue_bench: batch:  1523456 items/s  0.016 wakeups/item
+ *
+ *  A wakeup is counted whenever an item is consumed by a different worker
+ *  than the previous item on the same cpu, or by the same worker after it
+ *  slept.  The other parameters can be changed between passes.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/moduleparam.h>
+#include <linux/workqueue.h>
+#include <linux/kthread.h>
+#include <linux/completion.h>
+#include <linux/slab.h>
+#include <linux/ktime.h>
+#include <linux/sched.h>
+#include <linux/percpu.h>
+#include <linux/cpu.h>
+#include <linux/mutex.h>
+#include <linux/math64.h>
+#include <asm/div64.h>
+
+static unsigned int items = 16384;
+module_param(items, uint, 0644);
+MODULE_PARM_DESC(items, "items queued by each producer per pass");
+
+static unsigned int burst = 64;
+module_param(burst, uint, 0644);
+MODULE_PARM_DESC(burst, "items queued between two yields of a producer");
+
+static unsigned int target_offset;
+module_param(target_offset, uint, 0644);
+MODULE_PARM_DESC(target_offset,
+		 "consume items queued on cpu N on cpu N + target_offset");
+
+struct bench_item {
+	struct list_head	entry;
+	struct work_struct	work;
+};
+
+struct bench_consumer {
+	struct task_struct	*task;
+	unsigned long		nvcsw;
+};
+
+static DEFINE_PER_CPU(struct bench_consumer, bench_consumer);
+
+static DEFINE_MUTEX(bench_mutex);
+static struct workqueue_struct *bench_wq;
+static struct batch_work bench_bw;
+static bool bench_batch;
+static atomic_t bench_remaining;
+static atomic_long_t bench_wakeups;
+static DECLARE_COMPLETION(bench_done);
+
+static void bench_consumed(unsigned int nr)
+{
+	struct bench_consumer *c = &get_cpu_var(bench_consumer);
+
+	if (c->task != current || c->nvcsw != current->nvcsw)
+		atomic_long_inc(&bench_wakeups);
+	c->task = current;
+	c->nvcsw = current->nvcsw;
+	put_cpu_var(bench_consumer);
+
+	if (atomic_sub_and_test(nr, &bench_remaining))
+		complete(&bench_done);
+}
+
+static void bench_work_fn(struct work_struct *work)
+{
+	kfree(container_of(work, struct bench_item, work));
+	bench_consumed(1);
+}
+
+static void bench_batch_fn(struct batch_work *bw, struct list_head *list)
+{
+	struct bench_item *item, *next;
+	unsigned int nr = 0;
+
+	list_for_each_entry_safe(item, next, list, entry) {
+		list_del(&item->entry);
+		kfree(item);
+		nr++;
+	}
+	bench_consumed(nr);
+}
+
+static int bench_target(int cpu)
+{
+	int target = (cpu + target_offset) % nr_cpu_ids;
+
+	return cpu_online(target) ? target : cpu;
+}
+
+static int bench_producer(void *unused)
+{
+	int target = bench_target(raw_smp_processor_id());
+	struct bench_item *item;
+	unsigned int i;
+
+	for (i = 0; i < items; i++) {
+		/* kfree()d by the consumer; keep the count right if we fail */
+		item = kmalloc(sizeof(*item), GFP_KERNEL | __GFP_NOFAIL);
+		if (bench_batch) {
+			queue_batch_item(bench_wq, &bench_bw, &item->entry);
+		} else {
+			INIT_WORK(&item->work, bench_work_fn);
+			queue_work_on(target, bench_wq, &item->work);
+		}
+		if ((i + 1) % burst == 0)
+			yield();
+	}
+
+	return 0;
+}
+
+static void bench_run(bool batch)
+{
+	struct task_struct *p;
+	unsigned int nr = 0;
+	unsigned long wakeups;
+	u64 ns, rate, w;
+	ktime_t start;
+	int cpu;
+
+	get_online_cpus();
+
+	bench_batch = batch;
+	atomic_set(&bench_remaining, num_online_cpus() * items);
+	atomic_long_set(&bench_wakeups, 0);
+	INIT_COMPLETION(bench_done);
+	for_each_possible_cpu(cpu)
+		per_cpu(bench_consumer, cpu).task = NULL;
+
+	start = ktime_get();
+	for_each_online_cpu(cpu) {
+		p = kthread_create(bench_producer, NULL, "wq_bench/%d", cpu);
+		if (IS_ERR(p)) {
+			atomic_sub(items, &bench_remaining);
+			continue;
+		}
+		kthread_bind(p, cpu);
+		wake_up_process(p);
+		nr++;
+	}
+	if (nr)
+		wait_for_completion(&bench_done);
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	put_online_cpus();
+
+	if (!nr) {
+		printk(KERN_INFO "workqueue_bench: can't start producers\n");
+		return;
+	}
+
+	rate = div64_u64((u64)nr * items * NSEC_PER_SEC, ns ? ns : 1);
+	w = (u64)atomic_long_read(&bench_wakeups) * 1000;
+	do_div(w, nr * items);
+	wakeups = w;
+	printk(KERN_INFO "workqueue_bench: %-7s %8llu items/s  "
+	       "%lu.%03lu wakeups/item\n", batch ? "batch:" : "single:",
+	       (unsigned long long)rate, wakeups / 1000, wakeups % 1000);
+}
+
+static int bench_run_set(const char *val, const struct kernel_param *kp)
+{
+	int cpu;
+
+	/* Only once the module is loaded, not as an insmod argument */
+	if (!bench_wq)
+		return -EINVAL;
+
+	mutex_lock(&bench_mutex);
+	if (!items)
+		items = 1;
+	if (!burst)
+		burst = 1;
+	for_each_possible_cpu(cpu)
+		batch_work_set_affinity(&bench_bw, cpu,
+				(cpu + target_offset) % nr_cpu_ids);
+
+	printk(KERN_INFO "workqueue_bench: %u producers, %u items each, "
+	       "bursts of %u, target offset %u\n", num_online_cpus(),
+	       items, burst, target_offset);
+	bench_run(false);
+	bench_run(true);
+	mutex_unlock(&bench_mutex);
+
+	return 0;
+}
+
+static struct kernel_param_ops bench_run_ops = {
+	.set = bench_run_set,
+};
+module_param_cb(run, &bench_run_ops, NULL, 0200);
+MODULE_PARM_DESC(run, "write anything to run a pass");
+
+static int __init workqueue_bench_init(void)
+{
+	bench_wq = alloc_workqueue("wq_bench", 0, 0);
+	if (!bench_wq)
+		return -ENOMEM;
+	if (init_batch_work(&bench_bw, bench_batch_fn)) {
+		destroy_workqueue(bench_wq);
+		return -ENOMEM;
+	}
+	return 0;
+}
+
+static void __exit workqueue_bench_exit(void)
+{
+	destroy_batch_work(&bench_bw);
+	destroy_workqueue(bench_wq);
+}
+
+module_init(workqueue_bench_init);
+module_exit(workqueue_bench_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Benchmark of batched workqueue items");
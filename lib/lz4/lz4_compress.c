@@ -0,0 +1,161 @@
+/*
+ *  LZ4 Compressor
+ *
+ *  Single pass greedy compressor for the LZ4 block format described in
+ *  lz4defs.h.  A hash of the next four input bytes indexes a table of
+ *  previous positions; the search step grows while no match is found so
+ *  incompressible data is skipped over quickly.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/lz4.h>
+#include <asm/unaligned.h>
+#include "lz4defs.h"
+
+static inline u32 lz4_hash(const unsigned char *p)
+{
+	return (get_unaligned((const u32 *)p) * 2654435761U) >>
+		(32 - LZ4_HASH_LOG);
+}
+
+static inline int lz4_match4(const unsigned char *a, const unsigned char *b)
+{
+	return get_unaligned((const u32 *)a) == get_unaligned((const u32 *)b);
+}
+
+static inline unsigned char *lz4_put_length(unsigned char *op, size_t len)
+{
+	for (; len >= 255; len -= 255)
+		*op++ = 255;
+	*op++ = (unsigned char)len;
+	return op;
+}
+
+int lz4_compress(const unsigned char *src, size_t src_len,
+		unsigned char *dst, size_t *dst_len, void *wrkmem)
+{
+	u32 *table = wrkmem;
+	const unsigned char *ip = src;
+	const unsigned char *anchor = src;
+	const unsigned char *const iend = src + src_len;
+	const unsigned char *const mflimit = iend - MFLIMIT;
+	const unsigned char *const matchlimit = iend - LASTLITERALS;
+	const unsigned char *ref;
+	unsigned char *op = dst;
+	unsigned char *token;
+	size_t len;
+	u32 h;
+
+	if (src_len < MINLENGTH)
+		goto last_literals;
+
+	memset(table, 0, LZ4_MEM_COMPRESS);
+	table[lz4_hash(ip)] = 0;
+	ip++;
+
+	for (;;) {
+		const unsigned char *forward = ip;
+		unsigned int attempts = 1U << SKIPSTRENGTH;
+
+		/* Find a match */
+		do {
+			ip = forward;
+			forward = ip + (attempts++ >> SKIPSTRENGTH);
+			if (unlikely(forward > mflimit))
+				goto last_literals;
+
+			h = lz4_hash(ip);
+			ref = src + table[h];
+			table[h] = ip - src;
+		} while (ip - ref > MAX_DISTANCE || !lz4_match4(ref, ip));
+
+		/* Catch up */
+		while (ip > anchor && ref > src && ip[-1] == ref[-1]) {
+			ip--;
+			ref--;
+		}
+
+		/* Encode literal length and copy the literals */
+		len = ip - anchor;
+		token = op++;
+		if (len >= RUN_MASK) {
+			*token = RUN_MASK << ML_BITS;
+			op = lz4_put_length(op, len - RUN_MASK);
+		} else {
+			*token = len << ML_BITS;
+		}
+		memcpy(op, anchor, len);
+		op += len;
+
+next_match:
+		/* Encode offset */
+		put_unaligned_le16(ip - ref, op);
+		op += 2;
+
+		/* Find the match length */
+		ip += MINMATCH;
+		ref += MINMATCH;
+		anchor = ip;
+		while (ip < matchlimit - 3 && lz4_match4(ip, ref)) {
+			ip += 4;
+			ref += 4;
+		}
+		while (ip < matchlimit && *ip == *ref) {
+			ip++;
+			ref++;
+		}
+
+		/* Encode match length */
+		len = ip - anchor;
+		if (len >= ML_MASK) {
+			*token += ML_MASK;
+			op = lz4_put_length(op, len - ML_MASK);
+		} else {
+			*token += len;
+		}
+
+		anchor = ip;
+
+		/* The last match must start MFLIMIT bytes before the end */
+		if (ip > mflimit)
+			break;
+
+		table[lz4_hash(ip - 2)] = ip - 2 - src;
+
+		/* Test the next position for an immediate match */
+		h = lz4_hash(ip);
+		ref = src + table[h];
+		table[h] = ip - src;
+		if (ip - ref <= MAX_DISTANCE && lz4_match4(ref, ip)) {
+			token = op++;
+			*token = 0;
+			goto next_match;
+		}
+
+		ip++;
+	}
+
+last_literals:
+	len = iend - anchor;
+	if (len >= RUN_MASK) {
+		*op++ = RUN_MASK << ML_BITS;
+		op = lz4_put_length(op, len - RUN_MASK);
+	} else {
+		*op++ = len << ML_BITS;
+	}
+	memcpy(op, anchor, len);
+	op += len;
+
+	*dst_len = op - dst;
+	return LZ4_E_OK;
+}
+EXPORT_SYMBOL_GPL(lz4_compress);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("LZ4 Compressor");
@@ -0,0 +1,139 @@
+/*
+ *  LZ4 Decompressor
+ *
+ *  Safe decompressor for the LZ4 block format described in lz4defs.h.
+ *  Every length and offset read from the input is checked against the
+ *  input and output bounds, so corrupt or malicious data cannot cause
+ *  reads or writes outside the supplied buffers.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ */
+
+#ifndef STATIC
+#include <linux/module.h>
+#include <linux/kernel.h>
+#endif
+
+#include <linux/string.h>
+#include <linux/lz4.h>
+#include <asm/unaligned.h>
+#include "lz4defs.h"
+
+/*
+ * Returns the number of bytes written to 'dest' or a negative LZ4_E_*
+ * error.  Decoding stops at the end of the input, or, when 'full' is set,
+ * as soon as 'dest_len' bytes have been produced.
+ */
+static int lz4_uncompress(const unsigned char *src, size_t *src_len,
+		unsigned char *dest, size_t dest_len, int full)
+{
+	const unsigned char *ip = src;
+	const unsigned char *const iend = src + *src_len;
+	unsigned char *op = dest;
+	unsigned char *const oend = dest + dest_len;
+	const unsigned char *ref;
+	unsigned int token, s;
+	size_t length, offset, n;
+
+	while (ip < iend) {
+		token = *ip++;
+
+		/* Literals */
+		length = token >> ML_BITS;
+		if (length == RUN_MASK) {
+			do {
+				if (unlikely(ip >= iend))
+					return LZ4_E_INPUT_OVERRUN;
+				s = *ip++;
+				length += s;
+			} while (s == 255);
+		}
+
+		if (unlikely(length > (size_t)(iend - ip)))
+			return LZ4_E_INPUT_OVERRUN;
+		if (unlikely(length > (size_t)(oend - op)))
+			return LZ4_E_OUTPUT_OVERRUN;
+
+		memcpy(op, ip, length);
+		ip += length;
+		op += length;
+
+		/* The last sequence carries literals only */
+		if (ip == iend || (full && op == oend))
+			break;
+
+		/* Match */
+		if (unlikely(iend - ip < 2))
+			return LZ4_E_INPUT_OVERRUN;
+		offset = get_unaligned_le16(ip);
+		ip += 2;
+		if (unlikely(!offset || offset > (size_t)(op - dest)))
+			return LZ4_E_LOOKBEHIND_OVERRUN;
+		ref = op - offset;
+
+		length = token & ML_MASK;
+		if (length == ML_MASK) {
+			do {
+				if (unlikely(ip >= iend))
+					return LZ4_E_INPUT_OVERRUN;
+				s = *ip++;
+				length += s;
+			} while (s == 255);
+		}
+		length += MINMATCH;
+
+		if (unlikely(length > (size_t)(oend - op)))
+			return LZ4_E_OUTPUT_OVERRUN;
+
+		/*
+		 * Overlapping matches repeat the last 'offset' bytes.  Copy
+		 * in non-overlapping chunks; each chunk doubles the distance
+		 * already written so long runs need only a few memcpy calls.
+		 */
+		while (length) {
+			n = min_t(size_t, length, op - ref);
+			memcpy(op, ref, n);
+			op += n;
+			length -= n;
+		}
+	}
+
+	*src_len = ip - src;
+	return op - dest;
+}
+
+int lz4_decompress(const unsigned char *src, size_t *src_len,
+		unsigned char *dest, size_t actual_dest_len)
+{
+	int ret;
+
+	ret = lz4_uncompress(src, src_len, dest, actual_dest_len, 1);
+	if (ret < 0)
+		return ret;
+
+	return ret == actual_dest_len ? LZ4_E_OK : LZ4_E_ERROR;
+}
+#ifndef STATIC
+EXPORT_SYMBOL_GPL(lz4_decompress);
+#endif
+
+int lz4_decompress_unknownoutputsize(const unsigned char *src, size_t src_len,
+		unsigned char *dest, size_t *dest_len)
+{
+	int ret;
+
+	ret = lz4_uncompress(src, &src_len, dest, *dest_len, 0);
+	if (ret < 0)
+		return ret;
+
+	*dest_len = ret;
+	return LZ4_E_OK;
+}
+#ifndef STATIC
+EXPORT_SYMBOL_GPL(lz4_decompress_unknownoutputsize);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("LZ4 Decompressor");
+#endif
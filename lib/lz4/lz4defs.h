@@ -0,0 +1,29 @@
+/*
+ *  lz4defs.h -- common definitions of the LZ4 block format
+ *
+ *  The block format is a sequence of:
+ *	token		literal length (high nibble), match length (low nibble)
+ *	[length]	255-continued literal length if the nibble is 15
+ *	literals
+ *	offset		16 bit little-endian match distance
+ *	[length]	255-continued match length if the nibble is 15
+ *  The last sequence of a block holds literals only.
+ */
+
+#define MINMATCH	4
+
+#define COPYLENGTH	8
+#define LASTLITERALS	5
+#define MFLIMIT		(COPYLENGTH + MINMATCH)
+#define MINLENGTH	(MFLIMIT + 1)
+
+#define ML_BITS		4
+#define ML_MASK		((1U << ML_BITS) - 1)
+#define RUN_BITS	(8 - ML_BITS)
+#define RUN_MASK	((1U << RUN_BITS) - 1)
+
+#define MAXD_LOG	16
+#define MAX_DISTANCE	((1 << MAXD_LOG) - 1)
+
+/* Number of failed probes before the match search step grows. */
+#define SKIPSTRENGTH	6
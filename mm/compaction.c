@@ -14,6 +14,8 @@
 #include <linux/backing-dev.h>
 #include <linux/sysctl.h>
 #include <linux/sysfs.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
 #include "internal.h"
 
 #define CREATE_TRACE_POINTS
@@ -725,6 +727,191 @@ int sysctl_extfrag_handler(struct ctl_table *table, int write,
 	return 0;
 }
 
+/*
+ * Background compaction.  kswapd reclaims free memory but does nothing about
+ * how that memory is scattered, so high-order allocations that find enough
+ * free pages in the wrong shape end up compacting directly.  When kswapd
+ * finishes balancing a node for an order that a fragmentation index above
+ * extfrag_threshold says only compaction can satisfy, it hands the order to
+ * the node's kcompactd, which compacts the node's zones asynchronously.
+ * Runs are at least kcompactd_interval_ms apart; wakeups arriving sooner are
+ * merged into the next run.
+ */
+int sysctl_kcompactd_interval_ms = 500;
+
+/* Would compacting one of the zones at or below classzone_idx help order? */
+static bool kcompactd_node_suitable(pg_data_t *pgdat, int order,
+				    int classzone_idx)
+{
+	struct zone *zone;
+	int zoneid;
+
+	for (zoneid = 0; zoneid <= classzone_idx; zoneid++) {
+		zone = &pgdat->node_zones[zoneid];
+		if (!populated_zone(zone))
+			continue;
+
+		if (compaction_suitable(zone, order) == COMPACT_CONTINUE)
+			return true;
+	}
+
+	return false;
+}
+
+static void kcompactd_do_work(pg_data_t *pgdat)
+{
+	int order = pgdat->kcompactd_max_order;
+	int classzone_idx = pgdat->kcompactd_classzone_idx;
+	unsigned long status;
+	struct zone *zone;
+	int zoneid;
+
+	pgdat->kcompactd_max_order = 0;
+	pgdat->kcompactd_classzone_idx = 0;
+
+	count_vm_event(KCOMPACTD_WAKE);
+
+	for (zoneid = 0; zoneid <= classzone_idx; zoneid++) {
+		zone = &pgdat->node_zones[zoneid];
+		if (!populated_zone(zone))
+			continue;
+
+		if (compaction_deferred(zone))
+			continue;
+
+		if (compaction_suitable(zone, order) != COMPACT_CONTINUE)
+			continue;
+
+		status = compact_zone_order(zone, order, GFP_KERNEL, false);
+
+		/* Page migration frees to the PCP lists but we want merging */
+		preempt_disable();
+		drain_local_pages(NULL);
+		preempt_enable();
+
+		if (zone_watermark_ok(zone, order, low_wmark_pages(zone), 0, 0)) {
+			zone->compact_considered = 0;
+			zone->compact_defer_shift = 0;
+		} else if (status == COMPACT_COMPLETE) {
+			/* The whole zone was scanned and it did not help */
+			defer_compaction(zone);
+		}
+
+		if (kthread_should_stop())
+			return;
+	}
+}
+
+static bool kcompactd_work_requested(pg_data_t *pgdat)
+{
+	return kthread_should_stop() || pgdat->kcompactd_max_order > 0;
+}
+
+static int kcompactd(void *p)
+{
+	pg_data_t *pgdat = p;
+	const struct cpumask *cpumask = cpumask_of_node(pgdat->node_id);
+
+	if (!cpumask_empty(cpumask))
+		set_cpus_allowed_ptr(current, cpumask);
+	set_freezable();
+
+	pgdat->kcompactd_max_order = 0;
+	pgdat->kcompactd_classzone_idx = 0;
+	pgdat->kcompactd_next = jiffies;
+
+	while (!kthread_should_stop()) {
+		wait_event_freezable(pgdat->kcompactd_wait,
+				     kcompactd_work_requested(pgdat));
+
+		/* Let wakeups that come in quick succession share a run */
+		if (time_before(jiffies, pgdat->kcompactd_next)) {
+			count_vm_event(KCOMPACTD_THROTTLED);
+			schedule_timeout_interruptible(pgdat->kcompactd_next -
+						       jiffies);
+		}
+		if (kthread_should_stop())
+			break;
+
+		kcompactd_do_work(pgdat);
+		pgdat->kcompactd_next = jiffies +
+			msecs_to_jiffies(sysctl_kcompactd_interval_ms);
+	}
+
+	return 0;
+}
+
+/**
+ * wakeup_kcompactd - Ask for background compaction of a node
+ * @pgdat: The node kswapd has just balanced
+ * @order: The order of the allocations kswapd was woken for
+ * @classzone_idx: The highest zone those allocations may use
+ *
+ * kcompactd is only woken if the fragmentation index of one of the zones
+ * says that compaction, rather than more reclaim, would help @order.
+ */
+void wakeup_kcompactd(pg_data_t *pgdat, int order, int classzone_idx)
+{
+	if (!order || !pgdat->kcompactd)
+		return;
+
+	if (!kcompactd_node_suitable(pgdat, order, classzone_idx))
+		return;
+
+	if (pgdat->kcompactd_max_order < order)
+		pgdat->kcompactd_max_order = order;
+	if (pgdat->kcompactd_classzone_idx < classzone_idx)
+		pgdat->kcompactd_classzone_idx = classzone_idx;
+
+	if (!waitqueue_active(&pgdat->kcompactd_wait))
+		return;
+
+	wake_up_interruptible(&pgdat->kcompactd_wait);
+}
+
+/*
+ * Started for every node with memory at boot and by node-hot-add, next to
+ * kswapd.
+ */
+int kcompactd_run(int nid)
+{
+	pg_data_t *pgdat = NODE_DATA(nid);
+
+	if (pgdat->kcompactd)
+		return 0;
+
+	pgdat->kcompactd = kthread_run(kcompactd, pgdat, "kcompactd%d", nid);
+	if (IS_ERR(pgdat->kcompactd)) {
+		printk(KERN_ERR "Failed to start kcompactd on node %d\n", nid);
+		pgdat->kcompactd = NULL;
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Called by memory hotplug when all memory in a node is offlined.
+ */
+void kcompactd_stop(int nid)
+{
+	struct task_struct *kcompactd = NODE_DATA(nid)->kcompactd;
+
+	if (kcompactd) {
+		kthread_stop(kcompactd);
+		NODE_DATA(nid)->kcompactd = NULL;
+	}
+}
+
+static int __init kcompactd_init(void)
+{
+	int nid;
+
+	for_each_node_state(nid, N_HIGH_MEMORY)
+		kcompactd_run(nid);
+	return 0;
+}
+module_init(kcompactd_init)
+
 #if defined(CONFIG_SYSFS) && defined(CONFIG_NUMA)
 ssize_t sysfs_compact_node(struct sys_device *dev,
 			struct sysdev_attribute *attr,
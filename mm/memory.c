@@ -2394,6 +2394,45 @@ int apply_to_page_range(struct mm_struct *mm, unsigned long addr,
 }
 EXPORT_SYMBOL_GPL(apply_to_page_range);
 
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+/*
+ * A speculative fault is handled on a copy of the vma, see
+ * handle_speculative_fault().
+ */
+struct vma_snapshot {
+	struct vm_area_struct	vma;
+	struct vm_area_struct	*orig;
+	unsigned int		seq;
+	bool			changed;
+};
+
+/*
+ * Called with the pte lock held before a fault changes the pte.  Returns
+ * true if the fault is speculative and the vma has changed since it was
+ * copied, in which case the fault has to be backed out and handled again
+ * under mmap_sem.  Whoever changes a vma does so in vm_write_begin() before
+ * touching its ptes, which takes the same lock.
+ */
+static bool vma_has_changed(struct vm_area_struct *vma, unsigned int flags)
+{
+	struct vma_snapshot *snap;
+
+	if (!(flags & FAULT_FLAG_SPECULATIVE))
+		return false;
+
+	snap = container_of(vma, struct vma_snapshot, vma);
+	if (read_seqcount_retry(&snap->orig->vm_sequence, snap->seq))
+		snap->changed = true;
+	return snap->changed;
+}
+#else
+static inline bool vma_has_changed(struct vm_area_struct *vma,
+				   unsigned int flags)
+{
+	return false;
+}
+#endif
+
 /*
  * handle_pte_fault chooses page fault handler according to an entry
  * which was read non-atomically.  Before making any commitment, on
@@ -2465,7 +2504,7 @@ static inline void cow_user_page(struct page *dst, struct page *src, unsigned lo
  */
 static int do_wp_page(struct mm_struct *mm, struct vm_area_struct *vma,
 		unsigned long address, pte_t *page_table, pmd_t *pmd,
-		spinlock_t *ptl, pte_t orig_pte)
+		spinlock_t *ptl, pte_t orig_pte, unsigned int flags)
 	__releases(ptl)
 {
 	struct page *old_page, *new_page;
@@ -2500,7 +2539,8 @@ static int do_wp_page(struct mm_struct *mm, struct vm_area_struct *vma,
 			lock_page(old_page);
 			page_table = pte_offset_map_lock(mm, pmd, address,
 							 &ptl);
-			if (!pte_same(*page_table, orig_pte)) {
+			if (!pte_same(*page_table, orig_pte) ||
+			    vma_has_changed(vma, flags)) {
 				unlock_page(old_page);
 				goto unlock;
 			}
@@ -2569,7 +2609,8 @@ static int do_wp_page(struct mm_struct *mm, struct vm_area_struct *vma,
 			 */
 			page_table = pte_offset_map_lock(mm, pmd, address,
 							 &ptl);
-			if (!pte_same(*page_table, orig_pte)) {
+			if (!pte_same(*page_table, orig_pte) ||
+			    vma_has_changed(vma, flags)) {
 				unlock_page(old_page);
 				goto unlock;
 			}
@@ -2655,7 +2696,8 @@ gotten:
 	 * Re-check the pte - we dropped the lock
 	 */
 	page_table = pte_offset_map_lock(mm, pmd, address, &ptl);
-	if (likely(pte_same(*page_table, orig_pte))) {
+	if (likely(pte_same(*page_table, orig_pte) &&
+		   !vma_has_changed(vma, flags))) {
 		if (old_page) {
 			if (!PageAnon(old_page)) {
 				dec_mm_counter_fast(mm, MM_FILEPAGES);
@@ -2946,7 +2988,8 @@ static int do_swap_page(struct mm_struct *mm, struct vm_area_struct *vma,
 	 * Back out if somebody else already faulted in this pte.
 	 */
 	page_table = pte_offset_map_lock(mm, pmd, address, &ptl);
-	if (unlikely(!pte_same(*page_table, orig_pte)))
+	if (unlikely(!pte_same(*page_table, orig_pte) ||
+		     vma_has_changed(vma, flags)))
 		goto out_nomap;
 
 	if (unlikely(!PageUptodate(page))) {
@@ -3001,7 +3044,8 @@ static int do_swap_page(struct mm_struct *mm, struct vm_area_struct *vma,
 	}
 
 	if (flags & FAULT_FLAG_WRITE) {
-		ret |= do_wp_page(mm, vma, address, page_table, pmd, ptl, pte);
+		ret |= do_wp_page(mm, vma, address, page_table, pmd, ptl, pte,
+				  flags);
 		if (ret & VM_FAULT_ERROR)
 			ret &= VM_FAULT_ERROR;
 		goto out;
@@ -3085,7 +3129,7 @@ static int do_anonymous_page(struct mm_struct *mm, struct vm_area_struct *vma,
 		entry = pte_mkspecial(pfn_pte(my_zero_pfn(address),
 						vma->vm_page_prot));
 		page_table = pte_offset_map_lock(mm, pmd, address, &ptl);
-		if (!pte_none(*page_table))
+		if (!pte_none(*page_table) || vma_has_changed(vma, flags))
 			goto unlock;
 		goto setpte;
 	}
@@ -3106,7 +3150,7 @@ static int do_anonymous_page(struct mm_struct *mm, struct vm_area_struct *vma,
 		entry = pte_mkwrite(pte_mkdirty(entry));
 
 	page_table = pte_offset_map_lock(mm, pmd, address, &ptl);
-	if (!pte_none(*page_table))
+	if (!pte_none(*page_table) || vma_has_changed(vma, flags))
 		goto release;
 
 	inc_mm_counter_fast(mm, MM_ANONPAGES);
@@ -3258,7 +3302,8 @@ static int __do_fault(struct mm_struct *mm, struct vm_area_struct *vma,
 	 * handle that later.
 	 */
 	/* Only go through if we didn't race with anybody else... */
-	if (likely(pte_same(*page_table, orig_pte))) {
+	if (likely(pte_same(*page_table, orig_pte) &&
+		   !vma_has_changed(vma, flags))) {
 		flush_icache_page(vma, page);
 		entry = mk_pte(page, vma->vm_page_prot);
 		if (flags & FAULT_FLAG_WRITE)
@@ -3327,14 +3372,109 @@ uncharge_out:
 	return ret;
 }
 
+/**
+ * do_set_pte - map a page cache page with vm_page_prot for ->map_pages()
+ * @vma: virtual memory area
+ * @address: user virtual address
+ * @page: locked, uptodate page, with a reference that the mapping takes
+ * @pte: pointer to the empty pte, with the page table lock held
+ */
+void do_set_pte(struct vm_area_struct *vma, unsigned long address,
+		struct page *page, pte_t *pte)
+{
+	flush_icache_page(vma, page);
+	inc_mm_counter_fast(vma->vm_mm, MM_FILEPAGES);
+	page_add_file_rmap(page);
+	/*
+	 * vm_page_prot is read-only for private mappings and for shared ones
+	 * that track dirty pages, so writes to those still fault.
+	 */
+	set_pte_at(vma->vm_mm, address, pte, mk_pte(page, vma->vm_page_prot));
+
+	/* no need to invalidate: a not-present page won't be cached */
+	update_mmu_cache(vma, address, pte);
+}
+
+/*
+ * Bytes of a file mapping around a read fault that are mapped right away
+ * if their pages are in the page cache already, rounded down to a power
+ * of two pages.  A page or less disables fault-around.
+ */
+int sysctl_fault_around_bytes __read_mostly = 65536;
+
+static void do_fault_around(struct vm_area_struct *vma, unsigned long address,
+		pte_t *pte, pgoff_t pgoff, unsigned int flags)
+{
+	unsigned long start_addr, nr_pages, mask;
+	pgoff_t max_pgoff;
+	struct vm_fault vmf;
+	int off;
+
+	nr_pages = rounddown_pow_of_two(ACCESS_ONCE(sysctl_fault_around_bytes)
+					>> PAGE_SHIFT);
+	mask = ~(nr_pages * PAGE_SIZE - 1) & PAGE_MASK;
+
+	/* The window is aligned, so it never crosses a page table */
+	start_addr = max(address & mask, vma->vm_start);
+	off = ((address - start_addr) >> PAGE_SHIFT) & (PTRS_PER_PTE - 1);
+	pte -= off;
+	pgoff -= off;
+
+	/* Stop at the end of the window, of the page table or of the vma */
+	max_pgoff = pgoff - ((start_addr >> PAGE_SHIFT) & (PTRS_PER_PTE - 1)) +
+		PTRS_PER_PTE - 1;
+	max_pgoff = min3(max_pgoff, vma_pages(vma) + vma->vm_pgoff - 1,
+			 pgoff + nr_pages - 1);
+
+	/* Skip the ptes at the start that are populated already */
+	while (!pte_none(*pte)) {
+		if (++pgoff > max_pgoff)
+			return;
+		start_addr += PAGE_SIZE;
+		if (start_addr >= vma->vm_end)
+			return;
+		pte++;
+	}
+
+	vmf.virtual_address = (void __user *)start_addr;
+	vmf.pte = pte;
+	vmf.pgoff = pgoff;
+	vmf.max_pgoff = max_pgoff;
+	vmf.flags = flags;
+	vma->vm_ops->map_pages(vma, &vmf);
+}
+
 static int do_linear_fault(struct mm_struct *mm, struct vm_area_struct *vma,
 		unsigned long address, pte_t *page_table, pmd_t *pmd,
 		unsigned int flags, pte_t orig_pte)
 {
 	pgoff_t pgoff = (((address & PAGE_MASK)
 			- vma->vm_start) >> PAGE_SHIFT) + vma->vm_pgoff;
+	spinlock_t *ptl;
 
 	pte_unmap(page_table);
+
+	/*
+	 * Map the neighbouring pages that are in the page cache already,
+	 * in the hope that they are needed soon.  If the page we fault on
+	 * is one of them, that is all there is to do.
+	 */
+	if (!(flags & FAULT_FLAG_WRITE) && vma->vm_ops->map_pages &&
+	    !(vma->vm_flags & VM_NONLINEAR) &&
+	    (ACCESS_ONCE(sysctl_fault_around_bytes) >> PAGE_SHIFT) > 1) {
+		page_table = pte_offset_map_lock(mm, pmd, address, &ptl);
+		if (vma_has_changed(vma, flags)) {
+			pte_unmap_unlock(page_table, ptl);
+			return 0;
+		}
+		do_fault_around(vma, address, page_table, pgoff, flags);
+		if (!pte_same(*page_table, orig_pte)) {
+			pte_unmap_unlock(page_table, ptl);
+			return 0;
+		}
+		pte_unmap_unlock(page_table, ptl);
+	}
+
 	return __do_fault(mm, vma, address, pmd, pgoff, flags, orig_pte);
 }
 
@@ -3410,12 +3550,12 @@ int handle_pte_fault(struct mm_struct *mm,
 
 	ptl = pte_lockptr(mm, pmd);
 	spin_lock(ptl);
-	if (unlikely(!pte_same(*pte, entry)))
+	if (unlikely(!pte_same(*pte, entry) || vma_has_changed(vma, flags)))
 		goto unlock;
 	if (flags & FAULT_FLAG_WRITE) {
 		if (!pte_write(entry))
 			return do_wp_page(mm, vma, address,
-					pte, pmd, ptl, entry);
+					pte, pmd, ptl, entry, flags);
 		entry = pte_mkdirty(entry);
 	}
 	entry = pte_mkyoung(entry);
@@ -3437,7 +3577,8 @@ unlock:
 }
 
 /*
- * By the time we get here, we already hold the mm semaphore
+ * By the time we get here, we already hold the mm semaphore, unless the
+ * fault is speculative and vma is a copy (see handle_speculative_fault()).
  */
 int handle_mm_fault(struct mm_struct *mm, struct vm_area_struct *vma,
 		unsigned long address, unsigned int flags)
@@ -3503,6 +3644,118 @@ int handle_mm_fault(struct mm_struct *mm, struct vm_area_struct *vma,
 	return handle_pte_fault(mm, vma, address, pte, pmd, flags);
 }
 
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+/*
+ * find_vma() without mmap_sem and without updating mmap_cache.  The rbtree
+ * may be rebalanced under us, so the walk is bounded and may miss; the
+ * caller validates whatever is found.
+ */
+static struct vm_area_struct *find_vma_speculative(struct mm_struct *mm,
+						   unsigned long addr)
+{
+	struct vm_area_struct *vma = ACCESS_ONCE(mm->mmap_cache);
+	struct rb_node *node;
+	int depth = 0;
+
+	if (vma && vma->vm_start <= addr && addr < vma->vm_end)
+		return vma;
+
+	node = ACCESS_ONCE(mm->mm_rb.rb_node);
+	while (node && depth++ < 2 * BITS_PER_LONG) {
+		vma = rb_entry(node, struct vm_area_struct, vm_rb);
+		if (addr < vma->vm_start)
+			node = ACCESS_ONCE(node->rb_left);
+		else if (addr >= vma->vm_end)
+			node = ACCESS_ONCE(node->rb_right);
+		else
+			return vma;
+	}
+	return NULL;
+}
+
+/**
+ * handle_speculative_fault - handle a page fault without mmap_sem
+ * @mm: address space of the fault
+ * @address: faulting address
+ * @flags: FAULT_FLAG_xxx flags
+ * @vm_access: VM_READ, VM_WRITE and VM_EXEC flags, one of which the vma
+ *	must have for the access to be allowed
+ *
+ * Threads that fault while another thread of the process maps or unmaps
+ * memory otherwise queue up behind it on mmap_sem.  Here the vma is looked
+ * up and copied instead, and the fault is handled on the copy.  Before the
+ * pte is changed the copy is validated against the vma's sequence count
+ * under the pte lock.  mm->spf_sem keeps the vma and its page tables from
+ * being freed meanwhile; it is only taken for write, and briefly, by
+ * munmap and vma merging.
+ *
+ * Only anonymous vmas that have an anon_vma already and page cache backed
+ * file vmas are handled, and no write faults on shared file mappings.
+ *
+ * Returns VM_FAULT_RETRY if the fault has to be handled under mmap_sem
+ * instead: the vma couldn't be found, isn't handled here or changed under
+ * the fault, the access isn't allowed, or the fault failed.
+ */
+int handle_speculative_fault(struct mm_struct *mm, unsigned long address,
+			     unsigned int flags, unsigned long vm_access)
+{
+	struct vma_snapshot snap;
+	struct vm_area_struct *vma;
+	int ret = VM_FAULT_RETRY;
+
+	/* Fails while vmas or page tables are being freed */
+	if (!down_read_trylock(&mm->spf_sem))
+		goto out;
+
+	vma = find_vma_speculative(mm, address);
+	if (!vma)
+		goto out_unlock;
+
+	/* An odd count means the vma is changing or going away */
+	snap.seq = raw_read_seqcount(&vma->vm_sequence);
+	if (snap.seq & 1)
+		goto out_unlock;
+	snap.vma = *vma;
+	if (read_seqcount_retry(&vma->vm_sequence, snap.seq))
+		goto out_unlock;
+	snap.orig = vma;
+	snap.changed = false;
+	vma = &snap.vma;
+
+	if (vma->vm_mm != mm ||
+	    address < vma->vm_start || address >= vma->vm_end)
+		goto out_unlock;
+	if (!(vma->vm_flags & vm_access))
+		goto out_unlock;
+	/* Stacks may need expanding and locked vmas mlocking */
+	if (vma->vm_flags & (VM_HUGETLB | VM_NONLINEAR | VM_IO | VM_PFNMAP |
+			     VM_MIXEDMAP | VM_GROWSDOWN | VM_GROWSUP |
+			     VM_LOCKED))
+		goto out_unlock;
+	if (vma->vm_ops) {
+		if (vma->vm_ops->fault != filemap_fault)
+			goto out_unlock;
+		/* ->page_mkwrite() may rely on mmap_sem */
+		if ((flags & FAULT_FLAG_WRITE) && (vma->vm_flags & VM_SHARED))
+			goto out_unlock;
+	}
+	/* Setting up the anon_vma needs mmap_sem */
+	if ((!vma->vm_ops || (flags & FAULT_FLAG_WRITE)) && !vma->anon_vma)
+		goto out_unlock;
+
+	ret = handle_mm_fault(mm, vma, address,
+			      flags | FAULT_FLAG_SPECULATIVE);
+	if (snap.changed || (ret & VM_FAULT_ERROR))
+		ret = VM_FAULT_RETRY;
+out_unlock:
+	up_read(&mm->spf_sem);
+out:
+	count_vm_event(ret == VM_FAULT_RETRY ? SPECULATIVE_PGFAULT_ABORT :
+					       SPECULATIVE_PGFAULT);
+	return ret;
+}
+#endif /* CONFIG_SPECULATIVE_PAGE_FAULT */
+
 #ifndef __PAGETABLE_PUD_FOLDED
 /*
  * Allocate page upper directory.
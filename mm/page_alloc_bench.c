@@ -0,0 +1,194 @@
+/*
+ * Page allocator throughput for the orders cached on the per-cpu lists.
+ *
+ * Reading page_alloc_bench/run in debugfs allocates and frees bursts of
+ * pages of every order up to max_order on 1, 2, 4, ... and finally all
+ * online cpus, once as plain and once as __GFP_COMP pages, and returns
+ * the allocations per second of each run:
+ *
+ *	# cat /sys/kernel/debug/page_alloc_bench/run
+ *	order cpus     allocs/s  compound/s
+ *	    0    1      4123456           -
+ *	    3    4      2345678     2298765
+ *
+ * A burst that is larger than the batch of the per-cpu lists makes every
+ * refill go to the buddy lists, and contend on zone->lock.
+ */
+#include <linux/module.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/kernel.h>
+#include <linux/mm.h>
+#include <linux/gfp.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
+#include <linux/mutex.h>
+#include <linux/ktime.h>
+#include <linux/cpu.h>
+#include <linux/math64.h>
+
+static struct dentry *bench_dir;
+
+static u32 bench_allocs = 100000;
+static u32 bench_burst = 16;
+static u32 bench_max_order = PAGE_ALLOC_COSTLY_ORDER;
+
+static DEFINE_MUTEX(bench_mutex);
+static DEFINE_PER_CPU(struct work_struct, bench_work);
+static unsigned int bench_order;
+static gfp_t bench_gfp;
+static atomic_t bench_failed;
+
+static void bench_work_fn(struct work_struct *work)
+{
+	struct page **pages;
+	unsigned int i, n;
+
+	pages = kmalloc(bench_burst * sizeof(*pages), GFP_KERNEL);
+	if (!pages) {
+		atomic_inc(&bench_failed);
+		return;
+	}
+
+	for (i = 0; i < bench_allocs; i += n) {
+		for (n = 0; n < bench_burst && i + n < bench_allocs; n++) {
+			pages[n] = alloc_pages(bench_gfp, bench_order);
+			if (!pages[n]) {
+				atomic_inc(&bench_failed);
+				break;
+			}
+		}
+		while (n--)
+			__free_pages(pages[n], bench_order);
+		if (atomic_read(&bench_failed))
+			break;
+		cond_resched();
+	}
+
+	kfree(pages);
+}
+
+/* Returns allocations per second on the first nr_cpus online cpus */
+static u64 bench_run(unsigned int order, gfp_t gfp, unsigned int nr_cpus)
+{
+	unsigned int nr = 0;
+	ktime_t start;
+	u64 ns;
+	int cpu;
+
+	bench_order = order;
+	bench_gfp = gfp;
+	atomic_set(&bench_failed, 0);
+
+	start = ktime_get();
+	for_each_online_cpu(cpu) {
+		if (nr++ == nr_cpus)
+			break;
+		schedule_work_on(cpu, &per_cpu(bench_work, cpu));
+	}
+	for_each_online_cpu(cpu)
+		flush_work(&per_cpu(bench_work, cpu));
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	if (atomic_read(&bench_failed))
+		return 0;
+	return div64_u64((u64)nr_cpus * bench_allocs * NSEC_PER_SEC,
+			 ns ? ns : 1);
+}
+
+static void bench_show_one(struct seq_file *m, unsigned int order,
+			   unsigned int nr_cpus)
+{
+	seq_printf(m, "%5u %4u %12llu", order, nr_cpus,
+		   (unsigned long long)bench_run(order, GFP_KERNEL, nr_cpus));
+	if (order)
+		seq_printf(m, " %11llu\n", (unsigned long long)
+			   bench_run(order, GFP_KERNEL | __GFP_COMP, nr_cpus));
+	else
+		seq_printf(m, " %11s\n", "-");
+}
+
+static int bench_show(struct seq_file *m, void *v)
+{
+	unsigned int order, max_order, nr, cpus;
+
+	if (!bench_allocs || !bench_burst)
+		return -EINVAL;
+	max_order = min_t(u32, bench_max_order, MAX_ORDER - 1);
+
+	mutex_lock(&bench_mutex);
+	get_online_cpus();
+	cpus = num_online_cpus();
+
+	seq_printf(m, "order cpus     allocs/s  compound/s\n");
+	for (order = 0; order <= max_order; order++) {
+		for (nr = 1; nr < cpus; nr *= 2)
+			bench_show_one(m, order, nr);
+		bench_show_one(m, order, cpus);
+	}
+
+	put_online_cpus();
+	mutex_unlock(&bench_mutex);
+	return 0;
+}
+
+static int bench_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, bench_show, NULL);
+}
+
+static const struct file_operations bench_fops = {
+	.open		= bench_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void page_alloc_bench_exit(void)
+{
+	if (bench_dir)
+		debugfs_remove_recursive(bench_dir);
+}
+
+static int page_alloc_bench_init(void)
+{
+	struct dentry *dentry;
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		INIT_WORK(&per_cpu(bench_work, cpu), bench_work_fn);
+
+	bench_dir = debugfs_create_dir("page_alloc_bench", NULL);
+	if (bench_dir == NULL)
+		return -ENOMEM;
+
+	dentry = debugfs_create_file("run", 0400, bench_dir, NULL,
+				     &bench_fops);
+	if (!dentry)
+		goto fail;
+
+	dentry = debugfs_create_u32("allocs", 0600, bench_dir,
+				    &bench_allocs);
+	if (!dentry)
+		goto fail;
+
+	dentry = debugfs_create_u32("burst", 0600, bench_dir, &bench_burst);
+	if (!dentry)
+		goto fail;
+
+	dentry = debugfs_create_u32("max-order", 0600, bench_dir,
+				    &bench_max_order);
+	if (!dentry)
+		goto fail;
+
+	return 0;
+fail:
+	page_alloc_bench_exit();
+	return -ENOMEM;
+}
+
+module_init(page_alloc_bench_init);
+module_exit(page_alloc_bench_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Benchmark of the page allocator fast paths");
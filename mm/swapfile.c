@@ -32,6 +32,9 @@
 #include <linux/memcontrol.h>
 #include <linux/poll.h>
 #include <linux/oom.h>
+#include <linux/cpu.h>
+#include <linux/percpu.h>
+#include <linux/workqueue.h>
 
 #include <asm/pgtable.h>
 #include <asm/tlbflush.h>
@@ -64,6 +67,44 @@ static DECLARE_WAIT_QUEUE_HEAD(proc_poll_wait);
 /* Activity counter to indicate that a swapon or swapoff has occurred */
 static atomic_t proc_poll_event = ATOMIC_INIT(0);
 
+/*
+ * Per-cpu caches of swap slots.  get_swap_page() hands out slots from
+ * the cache of the local cpu and refills it with a whole batch at a time,
+ * so swap_lock is taken once per SWAP_SLOTS_CACHE_SIZE allocations.  Slots
+ * whose last reference goes away are parked in the free half of the cache
+ * and either handed out again by the next refill on that cpu, without
+ * going near the swap_map, or returned to their device in one go when
+ * the cache overflows.
+ *
+ * Cached slots are marked SWAP_HAS_CACHE in the swap_map, like a slot
+ * that was just allocated, so nobody else can take them; their count is
+ * zero, so swapcache_prepare() refuses them.
+ */
+#define SWAP_SLOTS_CACHE_SIZE	64
+
+struct swap_slots_cache {
+	struct mutex	alloc_lock;	/* protects slots, nr and cur */
+	int		nr;
+	int		cur;
+	swp_entry_t	slots[SWAP_SLOTS_CACHE_SIZE];
+	spinlock_t	free_lock;	/* protects slots_ret and n_ret */
+	int		n_ret;
+	swp_entry_t	slots_ret[SWAP_SLOTS_CACHE_SIZE];
+};
+
+static DEFINE_PER_CPU(struct swap_slots_cache, swp_slots);
+
+/* Raised under swap_lock while swapoff runs; the caches are empty then */
+static int swap_slots_cache_disabled;
+
+/* Whether the caches were in use at the last check, under swap_lock */
+static bool swap_slots_cache_active;
+
+/* Drains the caches from reclaim context, so it must not need memory */
+static struct workqueue_struct *swap_slots_wq;
+static void swap_slots_cache_drain_all(struct work_struct *work);
+static DECLARE_WORK(swap_slots_drain_work, swap_slots_cache_drain_all);
+
 static inline unsigned char swap_count(unsigned char ent)
 {
 	return ent & ~SWAP_HAS_CACHE;	/* may include SWAP_HAS_CONT flag */
@@ -409,17 +450,45 @@ no_page:
 	return 0;
 }
 
-swp_entry_t get_swap_page(void)
+/*
+ * Caching slots per cpu only makes sense while there is plenty of swap
+ * left; near the end, slots sitting in other cpus' caches would make
+ * allocations fail early.  When that point is reached, the slots still
+ * cached on every cpu are given back by swap_slots_drain_work, and
+ * get_swap_page() goes straight to the devices.  It does not wait for
+ * the drain, as it is called from reclaim; a few slots may be missed
+ * until the drain has run.  Called with swap_lock held.
+ */
+static bool swap_slots_cache_usable(void)
+{
+	bool usable = !swap_slots_cache_disabled &&
+		nr_swap_pages > num_online_cpus() * SWAP_SLOTS_CACHE_SIZE * 2;
+
+	if (!usable && swap_slots_cache_active)
+		queue_work(swap_slots_wq, &swap_slots_drain_work);
+	swap_slots_cache_active = usable;
+	return usable;
+}
+
+/*
+ * Allocate up to @n slots for the swap cache into @slots, returns the
+ * number allocated.  As many slots as possible are taken from one device
+ * in a row, so that they come out of the same cluster.
+ */
+static int get_swap_pages(int n, swp_entry_t slots[])
 {
 	struct swap_info_struct *si;
 	pgoff_t offset;
 	int type, next;
 	int wrapped = 0;
+	int nr = 0;
 
 	spin_lock(&swap_lock);
+	if (!swap_slots_cache_usable())
+		n = 1;
 	if (nr_swap_pages <= 0)
 		goto noswap;
-	nr_swap_pages--;
+	nr_swap_pages -= n;
 
 	for (type = swap_list.next; type >= 0 && wrapped < 2; type = next) {
 		si = swap_info[type];
@@ -436,19 +505,60 @@ swp_entry_t get_swap_page(void)
 			continue;
 
 		swap_list.next = next;
-		/* This is called for allocating swap entry for cache */
-		offset = scan_swap_map(si, SWAP_HAS_CACHE);
-		if (offset) {
-			spin_unlock(&swap_lock);
-			return swp_entry(type, offset);
+		while (nr < n) {
+			/* This is called for allocating swap entry for cache */
+			offset = scan_swap_map(si, SWAP_HAS_CACHE);
+			if (!offset)
+				break;
+			slots[nr++] = swp_entry(type, offset);
 		}
+		if (nr == n)
+			break;
 		next = swap_list.next;
 	}
 
-	nr_swap_pages++;
+	nr_swap_pages += n - nr;
 noswap:
 	spin_unlock(&swap_lock);
-	return (swp_entry_t) {0};
+	return nr;
+}
+
+swp_entry_t get_swap_page(void)
+{
+	struct swap_slots_cache *cache;
+	swp_entry_t entry = { 0 };
+
+	/* Racy, but get_swap_pages() checks again under swap_lock */
+	if (!ACCESS_ONCE(swap_slots_cache_active))
+		goto direct;
+
+	/* Migrating after this is fine, the cache is only used under its lock */
+	cache = __this_cpu_ptr(&swp_slots);
+
+	mutex_lock(&cache->alloc_lock);
+	if (cache->cur == cache->nr) {
+		/* Reuse the slots freed on this cpu before scanning for more */
+		spin_lock(&cache->free_lock);
+		memcpy(cache->slots, cache->slots_ret,
+		       cache->n_ret * sizeof(swp_entry_t));
+		cache->nr = cache->n_ret;
+		cache->n_ret = 0;
+		spin_unlock(&cache->free_lock);
+
+		cache->cur = 0;
+		if (!cache->nr)
+			cache->nr = get_swap_pages(SWAP_SLOTS_CACHE_SIZE,
+						   cache->slots);
+	}
+	if (cache->cur < cache->nr)
+		entry = cache->slots[cache->cur++];
+	mutex_unlock(&cache->alloc_lock);
+	if (entry.val)
+		return entry;
+
+direct:
+	get_swap_pages(1, &entry);
+	return entry;
 }
 
 /* The only caller of this function is now susupend routine */
@@ -509,6 +619,109 @@ out:
 	return NULL;
 }
 
+/*
+ * Give a slot without references back to its device.  Called with
+ * swap_lock held.
+ */
+static void swap_slot_release(swp_entry_t entry)
+{
+	struct swap_info_struct *p = swap_info[swp_type(entry)];
+	unsigned long offset = swp_offset(entry);
+
+	p->swap_map[offset] = 0;
+	if (offset < p->lowest_bit)
+		p->lowest_bit = offset;
+	if (offset > p->highest_bit)
+		p->highest_bit = offset;
+	if (swap_list.next >= 0 &&
+	    p->prio > swap_info[swap_list.next]->prio)
+		swap_list.next = p->type;
+	nr_swap_pages++;
+	p->inuse_pages--;
+}
+
+/*
+ * Park a slot whose last reference is gone in the cache of this cpu,
+ * returns false if it has to be released right away instead.  Called
+ * with swap_lock held, which also keeps us on this cpu.
+ */
+static bool swap_slot_cache_free(swp_entry_t entry)
+{
+	struct swap_slots_cache *cache;
+	int i;
+
+	if (!swap_slots_cache_usable())
+		return false;
+
+	cache = this_cpu_ptr(&swp_slots);
+	spin_lock(&cache->free_lock);
+	if (cache->n_ret == SWAP_SLOTS_CACHE_SIZE) {
+		for (i = 0; i < cache->n_ret; i++)
+			swap_slot_release(cache->slots_ret[i]);
+		cache->n_ret = 0;
+	}
+	cache->slots_ret[cache->n_ret++] = entry;
+	spin_unlock(&cache->free_lock);
+
+	return true;
+}
+
+/* Return all slots cached by @cpu to their devices */
+static void swap_slots_cache_drain(int cpu)
+{
+	struct swap_slots_cache *cache = &per_cpu(swp_slots, cpu);
+	int i;
+
+	mutex_lock(&cache->alloc_lock);
+	spin_lock(&swap_lock);
+	for (i = cache->cur; i < cache->nr; i++)
+		swap_slot_release(cache->slots[i]);
+	cache->cur = cache->nr = 0;
+
+	spin_lock(&cache->free_lock);
+	for (i = 0; i < cache->n_ret; i++)
+		swap_slot_release(cache->slots_ret[i]);
+	cache->n_ret = 0;
+	spin_unlock(&cache->free_lock);
+	spin_unlock(&swap_lock);
+	mutex_unlock(&cache->alloc_lock);
+}
+
+static void swap_slots_cache_drain_all(struct work_struct *work)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		swap_slots_cache_drain(cpu);
+}
+
+static int __cpuinit swap_slots_cache_callback(struct notifier_block *nfb,
+					       unsigned long action, void *hcpu)
+{
+	if (action == CPU_DEAD || action == CPU_DEAD_FROZEN)
+		swap_slots_cache_drain((long)hcpu);
+	return NOTIFY_OK;
+}
+
+static int __init swap_slots_cache_init(void)
+{
+	struct swap_slots_cache *cache;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		cache = &per_cpu(swp_slots, cpu);
+		mutex_init(&cache->alloc_lock);
+		spin_lock_init(&cache->free_lock);
+	}
+
+	swap_slots_wq = alloc_workqueue("swap_slots", WQ_MEM_RECLAIM, 1);
+	if (!swap_slots_wq)
+		swap_slots_cache_disabled++;
+	hotcpu_notifier(swap_slots_cache_callback, 0);
+	return 0;
+}
+__initcall(swap_slots_cache_init);
+
 static unsigned char swap_entry_free(struct swap_info_struct *p,
 				     swp_entry_t entry, unsigned char usage)
 {
@@ -548,18 +761,13 @@ static unsigned char swap_entry_free(struct swap_info_struct *p,
 	/* free if no reference */
 	if (!usage) {
 		struct gendisk *disk = p->bdev->bd_disk;
-		if (offset < p->lowest_bit)
-			p->lowest_bit = offset;
-		if (offset > p->highest_bit)
-			p->highest_bit = offset;
-		if (swap_list.next >= 0 &&
-		    p->prio > swap_info[swap_list.next]->prio)
-			swap_list.next = p->type;
-		nr_swap_pages++;
-		p->inuse_pages--;
 		if ((p->flags & SWP_BLKDEV) &&
 				disk->fops->swap_slot_free_notify)
 			disk->fops->swap_slot_free_notify(p->bdev, offset);
+		if (swap_slot_cache_free(entry))
+			p->swap_map[offset] = SWAP_HAS_CACHE;
+		else
+			swap_slot_release(entry);
 	}
 
 	return usage;
@@ -1615,10 +1823,24 @@ SYSCALL_DEFINE1(swapoff, const char __user *, specialfile)
 	p->flags &= ~SWP_WRITEOK;
 	spin_unlock(&swap_lock);
 
+	/*
+	 * try_to_unuse() has to wait for every slot still marked in the
+	 * swap_map, so no slot may sit in a cache while it runs.
+	 */
+	spin_lock(&swap_lock);
+	swap_slots_cache_disabled++;
+	spin_unlock(&swap_lock);
+	for_each_possible_cpu(i)
+		swap_slots_cache_drain(i);
+
 	oom_score_adj = test_set_oom_score_adj(OOM_SCORE_ADJ_MAX);
 	err = try_to_unuse(type);
 	test_set_oom_score_adj(oom_score_adj);
 
+	spin_lock(&swap_lock);
+	swap_slots_cache_disabled--;
+	spin_unlock(&swap_lock);
+
 	if (err) {
 		/*
 		 * reading p->prio and p->swap_map outside the lock is
@@ -2221,10 +2443,10 @@ static int __swap_duplicate(swp_entry_t entry, unsigned char usage)
 		/* set SWAP_HAS_CACHE if there is no cache and entry is used */
 		if (!has_cache && count)
 			has_cache = SWAP_HAS_CACHE;
-		else if (has_cache)		/* someone else added cache */
-			err = -EEXIST;
+		else if (has_cache && (count || swap_slots_cache_disabled))
+			err = -EEXIST;		/* someone else added cache */
 		else				/* no users remaining */
-			err = -ENOENT;
+			err = -ENOENT;		/* or a cached slot */
 
 	} else if (count || has_cache) {
 
@@ -2317,16 +2539,16 @@ int valid_swaphandles(swp_entry_t entry, unsigned long *offset)
 
 	/* Count contiguous allocated slots above our target */
 	for (toff = target; ++toff < end; nr_pages++) {
-		/* Don't read in free or bad pages */
-		if (!si->swap_map[toff])
+		/* Don't read in free, cached or bad pages */
+		if (!swap_count(si->swap_map[toff]))
 			break;
 		if (swap_count(si->swap_map[toff]) == SWAP_MAP_BAD)
 			break;
 	}
 	/* Count contiguous allocated slots below our target */
 	for (toff = target; --toff >= base; nr_pages++) {
-		/* Don't read in free or bad pages */
-		if (!si->swap_map[toff])
+		/* Don't read in free, cached or bad pages */
+		if (!swap_count(si->swap_map[toff]))
 			break;
 		if (swap_count(si->swap_map[toff]) == SWAP_MAP_BAD)
 			break;
@@ -183,6 +183,45 @@ int invalidate_inode_page(struct page *page)
 	return invalidate_complete_page(mapping, page);
 }
 
+/*
+ * Reclaim leaves the shadow entries of evicted pages in the tree (see
+ * mm/workingset.c); they have to go along with the pages they stand for.
+ */
+static void clear_shadow_entries(struct address_space *mapping,
+				 pgoff_t start, pgoff_t end)
+{
+	void **slots[PAGEVEC_SIZE];
+	unsigned long indices[PAGEVEC_SIZE];
+	unsigned long shadow_indices[PAGEVEC_SIZE];
+	unsigned int i, nr, nr_shadows;
+	void *entry;
+
+	while (mapping->nrshadows && start <= end) {
+		spin_lock_irq(&mapping->tree_lock);
+		nr = radix_tree_gang_lookup_slot(&mapping->page_tree, slots,
+						 indices, start, PAGEVEC_SIZE);
+		nr_shadows = 0;
+		for (i = 0; i < nr && indices[i] <= end; i++) {
+			entry = radix_tree_deref_slot_protected(slots[i],
+						&mapping->tree_lock);
+			if (radix_tree_exceptional_entry(entry))
+				shadow_indices[nr_shadows++] = indices[i];
+		}
+		/* Deleting may free nodes: done with the slots by now */
+		for (i = 0; i < nr_shadows; i++) {
+			radix_tree_delete(&mapping->page_tree,
+					  shadow_indices[i]);
+			mapping->nrshadows--;
+		}
+		spin_unlock_irq(&mapping->tree_lock);
+
+		if (nr < PAGEVEC_SIZE || indices[nr - 1] >= end)
+			break;
+		start = indices[nr - 1] + 1;
+		cond_resched();
+	}
+}
+
 /**
  * truncate_inode_pages - truncate range of pages specified by start & end byte offsets
  * @mapping: mapping to truncate
@@ -214,8 +253,12 @@ void truncate_inode_pages_range(struct address_space *mapping,
 	int i;
 
 	cleancache_flush_inode(mapping);
-	if (mapping->nrpages == 0)
-		return;
+	/* Pairs with the smp_wmb() in __delete_from_page_cache() */
+	if (mapping->nrpages == 0) {
+		smp_rmb();
+		if (mapping->nrshadows == 0)
+			return;
+	}
 
 	BUG_ON((lend & (PAGE_CACHE_SIZE - 1)) != (PAGE_CACHE_SIZE - 1));
 	end = (lend >> PAGE_CACHE_SHIFT);
@@ -292,6 +335,7 @@ void truncate_inode_pages_range(struct address_space *mapping,
 		mem_cgroup_uncharge_end();
 		index++;
 	}
+	clear_shadow_entries(mapping, start, end);
 	cleancache_flush_inode(mapping);
 }
 EXPORT_SYMBOL(truncate_inode_pages_range);
@@ -400,7 +444,7 @@ invalidate_complete_page2(struct address_space *mapping, struct page *page)
 
 	clear_page_mlock(page);
 	BUG_ON(page_has_private(page));
-	__delete_from_page_cache(page);
+	__delete_from_page_cache(page, NULL);
 	spin_unlock_irq(&mapping->tree_lock);
 	mem_cgroup_uncharge_cache_page(page);
 
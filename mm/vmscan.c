@@ -42,6 +42,7 @@
 #include <linux/delayacct.h>
 #include <linux/sysctl.h>
 #include <linux/oom.h>
+#include <linux/vmpressure.h>
 #include <linux/prefetch.h>
 
 #include <asm/tlbflush.h>
@@ -103,6 +104,9 @@ struct scan_control {
 	 */
 	reclaim_mode_t reclaim_mode;
 
+	/* Reclaim pages regardless of their referenced state */
+	int ignore_references;
+
 	/* Which cgroup do we reclaim from */
 	struct mem_cgroup *mem_cgroup;
 
@@ -519,9 +523,11 @@ static pageout_t pageout(struct page *page, struct address_space *mapping,
 
 /*
  * Same as remove_mapping, but if the page is removed from the mapping, it
- * gets returned with a refcount of 0.
+ * gets returned with a refcount of 0.  A file page that is @reclaimed
+ * leaves a shadow entry behind for refault detection.
  */
-static int __remove_mapping(struct address_space *mapping, struct page *page)
+static int __remove_mapping(struct address_space *mapping, struct page *page,
+			    bool reclaimed)
 {
 	BUG_ON(!PageLocked(page));
 	BUG_ON(mapping != page_mapping(page));
@@ -567,10 +573,13 @@ static int __remove_mapping(struct address_space *mapping, struct page *page)
 		swapcache_free(swap, page);
 	} else {
 		void (*freepage)(struct page *);
+		void *shadow = NULL;
 
 		freepage = mapping->a_ops->freepage;
 
-		__delete_from_page_cache(page);
+		if (reclaimed && page_is_file_cache(page))
+			shadow = workingset_eviction(mapping, page);
+		__delete_from_page_cache(page, shadow);
 		spin_unlock_irq(&mapping->tree_lock);
 		mem_cgroup_uncharge_cache_page(page);
 
@@ -593,7 +602,7 @@ cannot_free:
  */
 int remove_mapping(struct address_space *mapping, struct page *page)
 {
-	if (__remove_mapping(mapping, page)) {
+	if (__remove_mapping(mapping, page, false)) {
 		/*
 		 * Unfreezing the refcount with 1 rather than 2 effectively
 		 * drops the pagecache ref for us without requiring another
@@ -690,6 +699,10 @@ static enum page_references page_check_references(struct page *page,
 	int referenced_ptes, referenced_page;
 	unsigned long vm_flags;
 
+	/* Pages picked by the caller itself, e.g. per-process reclaim */
+	if (sc->ignore_references)
+		return PAGEREF_RECLAIM;
+
 	referenced_ptes = page_referenced(page, 1, sc->mem_cgroup, &vm_flags);
 	referenced_page = TestClearPageReferenced(page);
 
@@ -941,7 +954,7 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 			}
 		}
 
-		if (!mapping || !__remove_mapping(mapping, page))
+		if (!mapping || !__remove_mapping(mapping, page, true))
 			goto keep_locked;
 
 		/*
@@ -1002,6 +1015,66 @@ keep_lumpy:
 	return nr_reclaimed;
 }
 
+#ifdef CONFIG_PROCESS_RECLAIM
+/**
+ * reclaim_pages_from_list - reclaim a list of isolated pages
+ * @page_list: pages isolated with isolate_lru_page()
+ *
+ * Reclaims the pages on @page_list regardless of how recently they were
+ * referenced, swapping out anonymous pages and writing back dirty file
+ * pages as needed.  The caller must have accounted the pages in
+ * NR_ISOLATED_ANON and NR_ISOLATED_FILE.  Pages that could not be
+ * reclaimed are put back on the LRU lists, @page_list is empty on return.
+ *
+ * Returns the number of pages reclaimed.
+ */
+unsigned long reclaim_pages_from_list(struct list_head *page_list)
+{
+	struct scan_control sc = {
+		.gfp_mask = GFP_KERNEL,
+		.may_writepage = 1,
+		.may_unmap = 1,
+		.may_swap = 1,
+		.nr_to_reclaim = ULONG_MAX,
+		.ignore_references = 1,
+	};
+	unsigned long nr_reclaimed = 0;
+	LIST_HEAD(zone_list);
+	struct page *page, *next;
+	struct zone *zone;
+	int nr_anon, nr_file;
+
+	/* shrink_page_list() works on the pages of a single zone */
+	while (!list_empty(page_list)) {
+		zone = page_zone(lru_to_page(page_list));
+		nr_anon = nr_file = 0;
+		list_for_each_entry_safe(page, next, page_list, lru) {
+			if (page_zone(page) != zone)
+				continue;
+			ClearPageActive(page);
+			if (page_is_file_cache(page))
+				nr_file++;
+			else
+				nr_anon++;
+			list_move(&page->lru, &zone_list);
+		}
+
+		reset_reclaim_mode(&sc);
+		nr_reclaimed += shrink_page_list(&zone_list, zone, &sc);
+
+		while (!list_empty(&zone_list)) {
+			page = lru_to_page(&zone_list);
+			list_del(&page->lru);
+			putback_lru_page(page);
+		}
+		mod_zone_page_state(zone, NR_ISOLATED_ANON, -nr_anon);
+		mod_zone_page_state(zone, NR_ISOLATED_FILE, -nr_file);
+	}
+
+	return nr_reclaimed;
+}
+#endif
+
 /*
  * Attempt to remove the specified page from its LRU.  Only take this page
  * if it is of the appropriate PageActive status.  Pages which are being
@@ -1844,7 +1917,9 @@ static void get_scan_count(struct zone *zone, struct scan_control *sc,
 	/*
 	 * OK, so we have swap space and a fair amount of page cache
 	 * pages.  We use the recently rotated / recently scanned
-	 * ratios to determine how valuable each cache is.
+	 * ratios to determine how valuable each cache is.  File pages
+	 * that are activated on refault (see mm/workingset.c) count as
+	 * rotated, so a thrashing page cache shifts pressure to anon.
 	 *
 	 * Because workloads change over time (and to avoid overflow)
 	 * we keep these statistics as a floating average, which ends
@@ -2021,6 +2096,9 @@ restart:
 	if (inactive_anon_is_low(zone, sc))
 		shrink_active_list(SWAP_CLUSTER_MAX, zone, sc, priority, 0);
 
+	vmpressure(sc->gfp_mask, sc->mem_cgroup,
+		   sc->nr_scanned - nr_scanned, nr_reclaimed);
+
 	/* reclaim/compaction might need reclaim to continue */
 	if (should_continue_reclaim(zone, nr_reclaimed,
 					sc->nr_scanned - nr_scanned, sc))
@@ -2144,6 +2222,7 @@ static unsigned long do_try_to_free_pages(struct zonelist *zonelist,
 		count_vm_event(ALLOCSTALL);
 
 	for (priority = DEF_PRIORITY; priority >= 0; priority--) {
+		vmpressure_prio(sc->gfp_mask, sc->mem_cgroup, priority);
 		sc->nr_scanned = 0;
 		if (!priority)
 			disable_swap_token(sc->mem_cgroup);
@@ -2796,7 +2875,7 @@ static int kswapd(void *p)
 	order = new_order = 0;
 	classzone_idx = new_classzone_idx = pgdat->nr_zones - 1;
 	for ( ; ; ) {
-		int ret;
+		int ret, alloc_order;
 
 		/*
 		 * If the last balance_pgdat was unsuccessful it's unlikely a
@@ -2835,7 +2914,14 @@ static int kswapd(void *p)
 		 */
 		if (!ret) {
 			trace_mm_vmscan_kswapd_wake(pgdat->node_id, order);
+			alloc_order = order;
 			order = balance_pgdat(pgdat, order, &classzone_idx);
+
+			/*
+			 * Free pages alone may not make a block of the order
+			 * we were woken for; leave that to kcompactd.
+			 */
+			wakeup_kcompactd(pgdat, alloc_order, classzone_idx);
 		}
 	}
 	return 0;
@@ -708,6 +708,8 @@ const char * const vmstat_text[] = {
 	"nr_shmem",
 	"nr_dirtied",
 	"nr_written",
+	"workingset_refault",
+	"workingset_activate",
 
 #ifdef CONFIG_NUMA
 	"numa_hit",
@@ -721,6 +723,12 @@ const char * const vmstat_text[] = {
 	"nr_dirty_threshold",
 	"nr_dirty_background_threshold",
 
+#ifdef CONFIG_COMPACTION
+	"extfrag_index_order1",
+	"extfrag_index_order2",
+	"extfrag_index_order3",
+#endif
+
 #ifdef CONFIG_VM_EVENT_COUNTERS
 	"pgpgin",
 	"pgpgout",
@@ -735,6 +743,11 @@ const char * const vmstat_text[] = {
 
 	"pgfault",
 	"pgmajfault",
+	"pgfaultaround",
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+	"speculative_pgfault",
+	"speculative_pgfault_abort",
+#endif
 
 	TEXTS_FOR_ZONES("pgrefill")
 	TEXTS_FOR_ZONES("pgsteal")
@@ -763,6 +776,8 @@ const char * const vmstat_text[] = {
 	"compact_stall",
 	"compact_fail",
 	"compact_success",
+	"compact_daemon_wake",
+	"compact_daemon_throttled",
 #endif
 
 #ifdef CONFIG_HUGETLB_PAGE
@@ -1060,6 +1075,38 @@ enum writeback_stat_item {
 	NR_VM_WRITEBACK_STAT_ITEMS,
 };
 
+#ifdef CONFIG_COMPACTION
+/*
+ * Fragmentation index of all zones taken together for orders 1 to 3, the
+ * orders kernel stacks and network buffers ask for, in thousandths as in
+ * extfrag/extfrag_index.  Reported as 0 while an allocation of the order
+ * would still succeed.
+ */
+#define NR_VM_FRAGINDEX_STAT_ITEMS	3
+
+static void global_fragmentation_index(unsigned long *v)
+{
+	struct contig_page_info info, total;
+	struct zone *zone;
+	unsigned int order;
+	int index;
+
+	for (order = 1; order <= NR_VM_FRAGINDEX_STAT_ITEMS; order++) {
+		memset(&total, 0, sizeof(total));
+		for_each_populated_zone(zone) {
+			fill_contig_page_info(zone, order, &info);
+			total.free_pages += info.free_pages;
+			total.free_blocks_total += info.free_blocks_total;
+			total.free_blocks_suitable += info.free_blocks_suitable;
+		}
+		index = __fragmentation_index(order, &total);
+		v[order - 1] = max(index, 0);
+	}
+}
+#else
+#define NR_VM_FRAGINDEX_STAT_ITEMS	0
+#endif
+
 static void *vmstat_start(struct seq_file *m, loff_t *pos)
 {
 	unsigned long *v;
@@ -1068,7 +1115,8 @@ static void *vmstat_start(struct seq_file *m, loff_t *pos)
 	if (*pos >= ARRAY_SIZE(vmstat_text))
 		return NULL;
 	stat_items_size = NR_VM_ZONE_STAT_ITEMS * sizeof(unsigned long) +
-			  NR_VM_WRITEBACK_STAT_ITEMS * sizeof(unsigned long);
+			  NR_VM_WRITEBACK_STAT_ITEMS * sizeof(unsigned long) +
+			  NR_VM_FRAGINDEX_STAT_ITEMS * sizeof(unsigned long);
 
 #ifdef CONFIG_VM_EVENT_COUNTERS
 	stat_items_size += sizeof(struct vm_event_state);
@@ -1086,6 +1134,11 @@ static void *vmstat_start(struct seq_file *m, loff_t *pos)
 			    v + NR_DIRTY_THRESHOLD);
 	v += NR_VM_WRITEBACK_STAT_ITEMS;
 
+#ifdef CONFIG_COMPACTION
+	global_fragmentation_index(v);
+	v += NR_VM_FRAGINDEX_STAT_ITEMS;
+#endif
+
 #ifdef CONFIG_VM_EVENT_COUNTERS
 	all_vm_events(v);
 	v[PGPGIN] /= 2;		/* sectors -> kbytes */
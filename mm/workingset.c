@@ -0,0 +1,115 @@
+/*
+ * linux/mm/workingset.c
+ *
+ * Working set detection for the page cache
+ *
+ * When a file page is reclaimed, a shadow entry takes its place in the
+ * page cache radix tree.  It records the zone the page was in and the
+ * value of that zone's inactive_age counter at the time, which goes up
+ * by one on every eviction from and every activation on the zone's file
+ * LRU.
+ *
+ * When the page is faulted back in, the difference between the current
+ * inactive_age and the one in the shadow entry, the refault distance, is
+ * the number of pages that had to leave the inactive list, one way or the
+ * other, before the page came back.  Had the inactive list been bigger by
+ * that many pages, the page would still have been in memory.  The
+ * inactive list can only grow at the expense of the active list, so if
+ * the refault distance is not larger than the active list, the page is
+ * activated straight away and gets to compete with the pages on the
+ * active list instead of being pushed through the inactive list again.
+ *
+ * Activated refaults are accounted as rotated file pages, which makes
+ * get_scan_count() shift reclaim pressure from the file lists towards the
+ * anon lists while the page cache is thrashing.
+ *
+ * Both kinds of event are counted in workingset_refault and
+ * workingset_activate in /proc/vmstat.
+ */
+
+#include <linux/mm.h>
+#include <linux/mmzone.h>
+#include <linux/swap.h>
+#include <linux/radix-tree.h>
+
+#define EVICTION_SHIFT	(RADIX_TREE_EXCEPTIONAL_SHIFT + \
+			 ZONES_SHIFT + NODES_SHIFT)
+#define EVICTION_MASK	(~0UL >> EVICTION_SHIFT)
+
+static void *pack_shadow(unsigned long eviction, struct zone *zone)
+{
+	eviction = (eviction << NODES_SHIFT) | zone_to_nid(zone);
+	eviction = (eviction << ZONES_SHIFT) | zone_idx(zone);
+	eviction = (eviction << RADIX_TREE_EXCEPTIONAL_SHIFT);
+
+	return (void *)(eviction | RADIX_TREE_EXCEPTIONAL_ENTRY);
+}
+
+static void unpack_shadow(void *shadow, struct zone **zone,
+			  unsigned long *distance)
+{
+	unsigned long entry = (unsigned long)shadow;
+	unsigned long eviction, refault;
+	int zid, nid;
+
+	entry >>= RADIX_TREE_EXCEPTIONAL_SHIFT;
+	zid = entry & ((1UL << ZONES_SHIFT) - 1);
+	entry >>= ZONES_SHIFT;
+	nid = entry & ((1UL << NODES_SHIFT) - 1);
+	entry >>= NODES_SHIFT;
+	eviction = entry;
+
+	*zone = NODE_DATA(nid)->node_zones + zid;
+
+	/* The counter wraps within the bits the shadow entry has room for */
+	refault = atomic_long_read(&(*zone)->inactive_age);
+	*distance = (refault - eviction) & EVICTION_MASK;
+}
+
+/**
+ * workingset_eviction - note the eviction of a page from memory
+ * @mapping: address space the page was backing
+ * @page: the page being evicted
+ *
+ * Returns a shadow entry to be stored in @mapping->page_tree in place
+ * of the evicted @page so that a later refault can be detected.
+ */
+void *workingset_eviction(struct address_space *mapping, struct page *page)
+{
+	struct zone *zone = page_zone(page);
+	unsigned long eviction;
+
+	eviction = atomic_long_inc_return(&zone->inactive_age);
+	return pack_shadow(eviction, zone);
+}
+
+/**
+ * workingset_refault - evaluate the refault of a previously evicted page
+ * @shadow: shadow entry of the evicted page
+ *
+ * Calculates the refault distance of the page that is being faulted
+ * back in and returns true if it should be activated right away.
+ */
+bool workingset_refault(void *shadow)
+{
+	unsigned long refault_distance;
+	struct zone *zone;
+
+	unpack_shadow(shadow, &zone, &refault_distance);
+	inc_zone_state(zone, WORKINGSET_REFAULT);
+
+	if (refault_distance <= zone_page_state(zone, NR_ACTIVE_FILE)) {
+		inc_zone_state(zone, WORKINGSET_ACTIVATE);
+		return true;
+	}
+	return false;
+}
+
+/**
+ * workingset_activation - note a page activation
+ * @page: page that is being activated
+ */
+void workingset_activation(struct page *page)
+{
+	atomic_long_inc(&page_zone(page)->inactive_age);
+}
@@ -0,0 +1,257 @@
+/* $(CROSS_COMPILE)cc -Wall -Wextra -O2 -o afalg-aio-bench afalg-aio-bench.c */
+
+/*
+ * Measures AF_ALG skcipher throughput against the number of AIO reads
+ * kept in flight on one socket.  Each operation is a sendmsg() of one
+ * block with its own IV followed by an io_submit() of the read that
+ * returns the result, so with an async cipher (cryptd or pcrypt) the
+ * requests are processed in parallel.
+ *
+ *	afalg-aio-bench [-a alg] [-b bytes] [-d max depth] [-t seconds]
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/aio_abi.h>
+#include <linux/if_alg.h>
+
+#ifndef AF_ALG
+#define AF_ALG		38
+#define SOL_ALG		279
+#endif
+
+#define MAX_DEPTH	256
+#define IV_SIZE		16
+
+static const char *alg = "cbc(aes)";
+static unsigned int bsize = 4096;
+static unsigned int max_depth = 32;
+static unsigned int seconds = 2;
+
+static int io_setup(unsigned int nr, aio_context_t *ctx)
+{
+	return syscall(__NR_io_setup, nr, ctx);
+}
+
+static int io_submit(aio_context_t ctx, long nr, struct iocb **iocbs)
+{
+	return syscall(__NR_io_submit, ctx, nr, iocbs);
+}
+
+static int io_getevents(aio_context_t ctx, long min_nr, long nr,
+			struct io_event *events)
+{
+	return syscall(__NR_io_getevents, ctx, min_nr, nr, events, NULL);
+}
+
+static int io_destroy(aio_context_t ctx)
+{
+	return syscall(__NR_io_destroy, ctx);
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int alg_open(void)
+{
+	struct sockaddr_alg sa = {
+		.salg_family = AF_ALG,
+		.salg_type = "skcipher",
+	};
+	unsigned char key[16] = { 0 };
+	int tfmfd, opfd;
+
+	strncpy((char *)sa.salg_name, alg, sizeof(sa.salg_name) - 1);
+
+	tfmfd = socket(AF_ALG, SOCK_SEQPACKET, 0);
+	if (tfmfd < 0) {
+		perror("socket(AF_ALG)");
+		return -1;
+	}
+	if (bind(tfmfd, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+		fprintf(stderr, "bind %s: %s\n", alg, strerror(errno));
+		return -1;
+	}
+	if (setsockopt(tfmfd, SOL_ALG, ALG_SET_KEY, key, sizeof(key)) < 0) {
+		perror("ALG_SET_KEY");
+		return -1;
+	}
+
+	opfd = accept(tfmfd, NULL, 0);
+	if (opfd < 0)
+		perror("accept");
+	return opfd;
+}
+
+/* Queue one block with its own IV for encryption */
+static int send_block(int opfd, void *buf, unsigned int seq)
+{
+	char cbuf[CMSG_SPACE(sizeof(__u32)) +
+		  CMSG_SPACE(sizeof(struct af_alg_iv) + IV_SIZE)];
+	struct iovec iov = { .iov_base = buf, .iov_len = bsize };
+	struct msghdr msg = {
+		.msg_control = cbuf,
+		.msg_controllen = sizeof(cbuf),
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+	};
+	struct af_alg_iv *iv;
+	struct cmsghdr *cmsg;
+
+	memset(cbuf, 0, sizeof(cbuf));
+
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_ALG;
+	cmsg->cmsg_type = ALG_SET_OP;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(__u32));
+	*(__u32 *)CMSG_DATA(cmsg) = ALG_OP_ENCRYPT;
+
+	cmsg = CMSG_NXTHDR(&msg, cmsg);
+	cmsg->cmsg_level = SOL_ALG;
+	cmsg->cmsg_type = ALG_SET_IV;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(*iv) + IV_SIZE);
+	iv = (struct af_alg_iv *)CMSG_DATA(cmsg);
+	iv->ivlen = IV_SIZE;
+	memcpy(iv->iv, &seq, sizeof(seq));
+
+	return sendmsg(opfd, &msg, 0) == (ssize_t)bsize ? 0 : -1;
+}
+
+static int submit_read(aio_context_t ctx, int opfd, struct iocb *cb,
+		       void *buf, unsigned int slot)
+{
+	struct iocb *cbs[1] = { cb };
+
+	memset(cb, 0, sizeof(*cb));
+	cb->aio_fildes = opfd;
+	cb->aio_lio_opcode = IOCB_CMD_PREAD;
+	cb->aio_buf = (unsigned long)buf;
+	cb->aio_nbytes = bsize;
+	cb->aio_data = slot;
+
+	return io_submit(ctx, 1, cbs) == 1 ? 0 : -1;
+}
+
+static int run_depth(int opfd, unsigned int depth, char *in, char *out)
+{
+	static struct iocb cbs[MAX_DEPTH];
+	static struct io_event events[MAX_DEPTH];
+	static char busy[MAX_DEPTH];
+	unsigned long ops = 0;
+	unsigned int seq = 0, inflight = 0, i, slot;
+	aio_context_t ctx = 0;
+	double start, end;
+	int n;
+
+	if (io_setup(depth, &ctx) < 0) {
+		perror("io_setup");
+		return -1;
+	}
+
+	start = now();
+	end = start + seconds;
+	for (;;) {
+		for (slot = 0; inflight < depth && now() < end; slot++) {
+			if (busy[slot])
+				continue;
+			if (send_block(opfd, in + slot * bsize, seq++) ||
+			    submit_read(ctx, opfd, &cbs[slot],
+					out + slot * bsize, slot)) {
+				perror("submit");
+				return -1;
+			}
+			busy[slot] = 1;
+			inflight++;
+		}
+		if (!inflight)
+			break;
+
+		n = io_getevents(ctx, 1, depth, events);
+		if (n < 0) {
+			perror("io_getevents");
+			return -1;
+		}
+		for (i = 0; i < (unsigned int)n; i++) {
+			if (events[i].res != (__s64)bsize) {
+				fprintf(stderr, "read: %s\n",
+					strerror(-events[i].res));
+				return -1;
+			}
+			busy[events[i].data] = 0;
+			inflight--;
+			ops++;
+		}
+	}
+	end = now();
+
+	io_destroy(ctx);
+
+	printf("depth %3u: %9.0f ops/s %9.1f MB/s\n", depth,
+	       ops / (end - start), ops * bsize / (end - start) / 1e6);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int depth;
+	char *in, *out;
+	int opfd, c;
+
+	while ((c = getopt(argc, argv, "a:b:d:t:")) != -1) {
+		switch (c) {
+		case 'a':
+			alg = optarg;
+			break;
+		case 'b':
+			bsize = strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			max_depth = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			seconds = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-a alg] [-b bytes] "
+				"[-d max depth] [-t seconds]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (!bsize || bsize % 16 || !max_depth || max_depth > MAX_DEPTH) {
+		fprintf(stderr, "block size must be a multiple of 16, "
+			"depth at most %u\n", MAX_DEPTH);
+		return 1;
+	}
+
+	in = calloc(max_depth, bsize);
+	out = calloc(max_depth, bsize);
+	if (!in || !out)
+		return 1;
+
+	opfd = alg_open();
+	if (opfd < 0)
+		return 1;
+
+	printf("%s, %u byte blocks\n", alg, bsize);
+	for (depth = 1; depth <= max_depth; depth *= 2)
+		if (run_depth(opfd, depth, in, out))
+			return 1;
+
+	return 0;
+}
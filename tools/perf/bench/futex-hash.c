@@ -0,0 +1,156 @@
+/*
+ *
+ * futex-hash.c
+ *
+ * hash: Contention on the futex hash table
+ *
+ * Every thread issues FUTEX_WAIT on each of its own futexes in turn, with
+ * a value that never matches.  Each operation then only hashes the futex,
+ * takes the lock of its hash bucket and returns -EWOULDBLOCK, so the
+ * operation rate drops as the threads collide on the buckets.
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+#include "futex.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+static int nr_threads;
+static int nr_futexes = 1024;
+static int runtime_secs = 10;
+static bool fshared;
+
+static const struct option options[] = {
+	OPT_INTEGER('t', "threads", &nr_threads,
+		    "Specify number of threads (default: online cpus)"),
+	OPT_INTEGER('f', "futexes", &nr_futexes,
+		    "Specify number of futexes per thread"),
+	OPT_INTEGER('r', "runtime", &runtime_secs,
+		    "Specify benchmark runtime in seconds"),
+	OPT_BOOLEAN('s', "shared", &fshared,
+		    "Use shared futexes instead of private ones"),
+	OPT_END()
+};
+
+static const char * const bench_futex_hash_usage[] = {
+	"perf bench futex hash <options>",
+	NULL
+};
+
+struct hash_worker {
+	pthread_t	thread;
+	u_int32_t	*futexes;
+	unsigned long long ops;
+};
+
+static volatile int done;
+static int opflags;
+
+static void *hash_thread(void *arg)
+{
+	struct hash_worker *w = arg;
+	int i;
+
+	while (!done) {
+		for (i = 0; i < nr_futexes; i++) {
+			/* The futexes hold 0, this never sleeps */
+			if (futex_wait(&w->futexes[i], 1234, NULL, opflags) &&
+			    errno != EWOULDBLOCK && errno != EAGAIN)
+				die("futex_wait");
+		}
+		w->ops += nr_futexes;
+	}
+
+	return NULL;
+}
+
+int bench_futex_hash(int argc, const char **argv,
+		     const char *prefix __used)
+{
+	struct hash_worker *workers;
+	struct timeval start, stop, diff;
+	unsigned long long ops = 0, min = ~0ULL, max = 0;
+	double secs;
+	int i;
+
+	argc = parse_options(argc, argv, options,
+			     bench_futex_hash_usage, 0);
+
+	if (!nr_threads)
+		nr_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nr_threads <= 0 || nr_futexes <= 0 || runtime_secs <= 0) {
+		fprintf(stderr, "Invalid thread or futex count\n");
+		return 1;
+	}
+	if (!fshared)
+		opflags = FUTEX_PRIVATE_FLAG;
+
+	workers = calloc(nr_threads, sizeof(*workers));
+	if (!workers)
+		die("calloc");
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < nr_threads; i++) {
+		workers[i].futexes = calloc(nr_futexes, sizeof(u_int32_t));
+		if (!workers[i].futexes)
+			die("calloc");
+		if (pthread_create(&workers[i].thread, NULL,
+				   hash_thread, &workers[i]))
+			die("pthread_create");
+	}
+
+	sleep(runtime_secs);
+	done = 1;
+
+	for (i = 0; i < nr_threads; i++)
+		pthread_join(workers[i].thread, NULL);
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+	secs = diff.tv_sec + diff.tv_usec / 1000000.0;
+
+	for (i = 0; i < nr_threads; i++) {
+		ops += workers[i].ops;
+		if (workers[i].ops < min)
+			min = workers[i].ops;
+		if (workers[i].ops > max)
+			max = workers[i].ops;
+		free(workers[i].futexes);
+	}
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %d threads with %d %s futexes each for %d sec\n\n",
+		       nr_threads, nr_futexes,
+		       fshared ? "shared" : "private", runtime_secs);
+		printf(" %14.0f ops/sec\n", ops / secs);
+		printf(" %14.0f ops/sec per thread (avg)\n",
+		       ops / secs / nr_threads);
+		printf(" %14.0f ops/sec per thread (min)\n", min / secs);
+		printf(" %14.0f ops/sec per thread (max)\n", max / secs);
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%.0f\n", ops / secs);
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	free(workers);
+	return 0;
+}
@@ -0,0 +1,154 @@
+/*
+ *
+ * futex-requeue.c
+ *
+ * requeue: Requeueing of the waiters of a futex onto another one
+ *
+ * A set of threads block on one futex and are moved to a second futex a
+ * few at a time with FUTEX_CMP_REQUEUE, the way a condition variable
+ * broadcast hands its waiters over to the mutex, measuring how long the
+ * requeueing takes.  The waiters are then woken on the second futex.
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+#include "futex.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+static int nr_threads;
+static int nr_requeue = 1;
+static int nr_iterations = 10;
+static bool fshared;
+
+static const struct option options[] = {
+	OPT_INTEGER('t', "threads", &nr_threads,
+		    "Specify number of waiters (default: online cpus)"),
+	OPT_INTEGER('q', "nrequeue", &nr_requeue,
+		    "Specify number of waiters to requeue per call"),
+	OPT_INTEGER('i', "iterations", &nr_iterations,
+		    "Specify number of times to block and requeue the waiters"),
+	OPT_BOOLEAN('s', "shared", &fshared,
+		    "Use shared futexes instead of private ones"),
+	OPT_END()
+};
+
+static const char * const bench_futex_requeue_usage[] = {
+	"perf bench futex requeue <options>",
+	NULL
+};
+
+static u_int32_t futex1, futex2;
+static int opflags;
+static int nr_started;
+
+static void *requeue_waiter(void *arg __used)
+{
+	__sync_fetch_and_add(&nr_started, 1);
+	futex_wait(&futex1, 0, NULL, opflags);
+	return NULL;
+}
+
+/* Start the waiters and give them time to block */
+static void block_waiters(pthread_t *threads)
+{
+	int i;
+
+	nr_started = 0;
+	for (i = 0; i < nr_threads; i++) {
+		if (pthread_create(&threads[i], NULL, requeue_waiter, NULL))
+			die("pthread_create");
+	}
+	while (nr_started < nr_threads)
+		usleep(1000);
+	usleep(100000);
+}
+
+int bench_futex_requeue(int argc, const char **argv,
+			const char *prefix __used)
+{
+	unsigned long long usecs, sum = 0, max = 0;
+	struct timeval start, stop, diff;
+	pthread_t *threads;
+	int i, j, ret, moved, calls = 0;
+
+	argc = parse_options(argc, argv, options,
+			     bench_futex_requeue_usage, 0);
+
+	if (!nr_threads)
+		nr_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nr_threads <= 0 || nr_requeue <= 0 || nr_iterations <= 0) {
+		fprintf(stderr, "Invalid thread, requeue or iteration count\n");
+		return 1;
+	}
+	if (!fshared)
+		opflags = FUTEX_PRIVATE_FLAG;
+
+	threads = calloc(nr_threads, sizeof(*threads));
+	if (!threads)
+		die("calloc");
+
+	for (i = 0; i < nr_iterations; i++) {
+		block_waiters(threads);
+
+		/* Waiters not blocked yet are moved by a later call */
+		moved = 0;
+		gettimeofday(&start, NULL);
+		while (moved < nr_threads) {
+			ret = futex_cmp_requeue(&futex1, 0, &futex2, 0,
+						nr_requeue, opflags);
+			if (ret < 0)
+				die("futex_cmp_requeue");
+			moved += ret;
+			calls++;
+		}
+		gettimeofday(&stop, NULL);
+
+		timersub(&stop, &start, &diff);
+		usecs = diff.tv_sec * 1000000ULL + diff.tv_usec;
+		sum += usecs;
+		if (usecs > max)
+			max = usecs;
+
+		moved = 0;
+		while (moved < nr_threads)
+			moved += futex_wake(&futex2, nr_threads, opflags);
+		for (j = 0; j < nr_threads; j++)
+			pthread_join(threads[j], NULL);
+	}
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %d %s waiters requeued %d per call, %d times\n\n",
+		       nr_threads, fshared ? "shared" : "private", nr_requeue,
+		       nr_iterations);
+		printf(" %14.1f usecs to requeue all waiters (avg)\n",
+		       (double)sum / nr_iterations);
+		printf(" %14llu usecs to requeue all waiters (max)\n", max);
+		printf(" %14.2f usecs per FUTEX_CMP_REQUEUE call\n",
+		       (double)sum / calls);
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%.1f\n", (double)sum / nr_iterations);
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	free(threads);
+	return 0;
+}
@@ -0,0 +1,147 @@
+/*
+ *
+ * futex-wake.c
+ *
+ * wake: Wakeup of the waiters of a futex
+ *
+ * A set of threads block on one futex, which is then woken a few waiters
+ * per FUTEX_WAKE call until all of them are up, measuring how long the
+ * wakeups take.  This is what a condition variable broadcast or a heavily
+ * contended mutex costs the waking thread.
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+#include "futex.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+static int nr_threads;
+static int nr_wake = 1;
+static int nr_iterations = 10;
+static bool fshared;
+
+static const struct option options[] = {
+	OPT_INTEGER('t', "threads", &nr_threads,
+		    "Specify number of waiters (default: online cpus)"),
+	OPT_INTEGER('w', "nwakes", &nr_wake,
+		    "Specify number of waiters to wake per call"),
+	OPT_INTEGER('i', "iterations", &nr_iterations,
+		    "Specify number of times to block and wake the waiters"),
+	OPT_BOOLEAN('s', "shared", &fshared,
+		    "Use a shared futex instead of a private one"),
+	OPT_END()
+};
+
+static const char * const bench_futex_wake_usage[] = {
+	"perf bench futex wake <options>",
+	NULL
+};
+
+static u_int32_t futex_word;
+static int opflags;
+static int nr_started;
+
+static void *wake_waiter(void *arg __used)
+{
+	__sync_fetch_and_add(&nr_started, 1);
+	futex_wait(&futex_word, 0, NULL, opflags);
+	return NULL;
+}
+
+/* Start the waiters and give them time to block */
+static void block_waiters(pthread_t *threads)
+{
+	int i;
+
+	nr_started = 0;
+	for (i = 0; i < nr_threads; i++) {
+		if (pthread_create(&threads[i], NULL, wake_waiter, NULL))
+			die("pthread_create");
+	}
+	while (nr_started < nr_threads)
+		usleep(1000);
+	usleep(100000);
+}
+
+int bench_futex_wake(int argc, const char **argv,
+		     const char *prefix __used)
+{
+	unsigned long long usecs, sum = 0, max = 0;
+	struct timeval start, stop, diff;
+	pthread_t *threads;
+	int i, j, woken, calls = 0;
+
+	argc = parse_options(argc, argv, options,
+			     bench_futex_wake_usage, 0);
+
+	if (!nr_threads)
+		nr_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nr_threads <= 0 || nr_wake <= 0 || nr_iterations <= 0) {
+		fprintf(stderr, "Invalid thread, wake or iteration count\n");
+		return 1;
+	}
+	if (!fshared)
+		opflags = FUTEX_PRIVATE_FLAG;
+
+	threads = calloc(nr_threads, sizeof(*threads));
+	if (!threads)
+		die("calloc");
+
+	for (i = 0; i < nr_iterations; i++) {
+		block_waiters(threads);
+
+		/* Waiters not blocked yet are woken by a later call */
+		woken = 0;
+		gettimeofday(&start, NULL);
+		while (woken < nr_threads) {
+			woken += futex_wake(&futex_word, nr_wake, opflags);
+			calls++;
+		}
+		gettimeofday(&stop, NULL);
+
+		timersub(&stop, &start, &diff);
+		usecs = diff.tv_sec * 1000000ULL + diff.tv_usec;
+		sum += usecs;
+		if (usecs > max)
+			max = usecs;
+
+		for (j = 0; j < nr_threads; j++)
+			pthread_join(threads[j], NULL);
+	}
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %d %s waiters woken %d per call, %d times\n\n",
+		       nr_threads, fshared ? "shared" : "private", nr_wake,
+		       nr_iterations);
+		printf(" %14.1f usecs to wake all waiters (avg)\n",
+		       (double)sum / nr_iterations);
+		printf(" %14llu usecs to wake all waiters (max)\n", max);
+		printf(" %14.2f usecs per FUTEX_WAKE call\n",
+		       (double)sum / calls);
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%.1f\n", (double)sum / nr_iterations);
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	free(threads);
+	return 0;
+}
@@ -0,0 +1,55 @@
+/*
+ *
+ * futex.h
+ *
+ * Glibc has no wrappers for the futex syscall, these are shared by the
+ * futex benchmarks.
+ *
+ */
+
+#ifndef _FUTEX_H
+#define _FUTEX_H
+
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <linux/futex.h>
+
+static inline int
+futex(u_int32_t *uaddr, int op, u_int32_t val, const struct timespec *timeout,
+      u_int32_t *uaddr2, u_int32_t val3, int opflags)
+{
+	return syscall(SYS_futex, uaddr, op | opflags, val, timeout,
+		       uaddr2, val3);
+}
+
+/* Sleep on uaddr as long as it holds val */
+static inline int
+futex_wait(u_int32_t *uaddr, u_int32_t val, struct timespec *timeout,
+	   int opflags)
+{
+	return futex(uaddr, FUTEX_WAIT, val, timeout, NULL, 0, opflags);
+}
+
+/* Wake up to nr_wake waiters of uaddr, returns the number woken */
+static inline int
+futex_wake(u_int32_t *uaddr, int nr_wake, int opflags)
+{
+	return futex(uaddr, FUTEX_WAKE, nr_wake, NULL, NULL, 0, opflags);
+}
+
+/*
+ * If uaddr still holds val, wake up to nr_wake waiters of uaddr and move
+ * up to nr_requeue of the others to uaddr2.  Returns the number of waiters
+ * woken or requeued.
+ */
+static inline int
+futex_cmp_requeue(u_int32_t *uaddr, u_int32_t val, u_int32_t *uaddr2,
+		  int nr_wake, int nr_requeue, int opflags)
+{
+	return futex(uaddr, FUTEX_CMP_REQUEUE, nr_wake,
+		     (struct timespec *)(long)nr_requeue, uaddr2, val,
+		     opflags);
+}
+
+#endif /* _FUTEX_H */
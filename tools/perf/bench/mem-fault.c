@@ -0,0 +1,269 @@
+/*
+ *
+ * mem-fault.c
+ *
+ * fault: Benchmark for page faults against concurrent mmap and munmap
+ *
+ * A set of threads keeps faulting in the pages of a region of its own,
+ * dropping them with MADV_DONTNEED after every pass, while another set
+ * of threads keeps mapping, touching and unmapping small regions of
+ * anonymous memory, the way a JIT compiler or a garbage collected heap
+ * does.  Each fault is timed; a fault that has to wait for mmap_sem
+ * behind a mapping thread shows up in the maximum latency.  With
+ * CONFIG_SPECULATIVE_PAGE_FAULT the faults handled without mmap_sem are
+ * taken from /proc/vmstat as well.
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+static int nr_faulters;
+static int nr_mappers = 1;
+static int size_mb = 16;
+static int map_kb = 64;
+static int runtime_secs = 5;
+static const char *file;
+
+static const struct option options[] = {
+	OPT_INTEGER('t', "threads", &nr_faulters,
+		    "Specify number of faulting threads"),
+	OPT_INTEGER('m', "mappers", &nr_mappers,
+		    "Specify number of threads doing mmap and munmap"),
+	OPT_INTEGER('s', "size", &size_mb,
+		    "Specify MB faulted in per thread and pass"),
+	OPT_INTEGER('k', "map-size", &map_kb,
+		    "Specify KB mapped by a mapping thread at a time"),
+	OPT_INTEGER('r', "runtime", &runtime_secs,
+		    "Specify benchmark runtime in seconds"),
+	OPT_STRING('f', "file", &file, "path",
+		   "Fault on a private mapping of this file"),
+	OPT_END()
+};
+
+static const char * const bench_mem_fault_usage[] = {
+	"perf bench mem fault <options>",
+	NULL
+};
+
+struct fault_worker {
+	pthread_t	thread;
+	int		mapper;
+	unsigned long long ops;
+	unsigned long long lat_sum;
+	unsigned long long lat_max;
+};
+
+static volatile int done;
+static size_t page_size;
+static int file_fd = -1;
+
+static unsigned long long now_nsecs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int read_vmstat(const char *name, unsigned long long *val)
+{
+	unsigned long long v;
+	char key[64];
+	int ret = -1;
+	FILE *f;
+
+	f = fopen("/proc/vmstat", "r");
+	if (!f)
+		return -1;
+	while (fscanf(f, "%63s %llu", key, &v) == 2) {
+		if (!strcmp(key, name)) {
+			*val = v;
+			ret = 0;
+			break;
+		}
+	}
+	fclose(f);
+
+	return ret;
+}
+
+static void *fault_thread(void *arg)
+{
+	struct fault_worker *w = arg;
+	size_t len = (size_t)size_mb << 20, off;
+	unsigned long long start, lat;
+	volatile char *p;
+
+	if (file_fd >= 0)
+		p = mmap(NULL, len, PROT_READ, MAP_PRIVATE, file_fd, 0);
+	else
+		p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+			 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED)
+		die("mmap");
+
+	while (!done) {
+		for (off = 0; off < len && !done; off += page_size) {
+			start = now_nsecs();
+			if (file_fd >= 0)
+				(void)p[off];
+			else
+				p[off] = 1;
+			lat = now_nsecs() - start;
+
+			w->lat_sum += lat;
+			if (lat > w->lat_max)
+				w->lat_max = lat;
+			w->ops++;
+		}
+		madvise((void *)p, len, MADV_DONTNEED);
+	}
+
+	munmap((void *)p, len);
+	return NULL;
+}
+
+static void *map_thread(void *arg)
+{
+	struct fault_worker *w = arg;
+	size_t len = (size_t)map_kb << 10;
+	char *p;
+
+	while (!done) {
+		p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+			 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (p == MAP_FAILED)
+			die("mmap");
+		p[0] = 1;
+		munmap(p, len);
+		w->ops++;
+	}
+
+	return NULL;
+}
+
+int bench_mem_fault(int argc, const char **argv,
+		    const char *prefix __used)
+{
+	unsigned long long spf0 = 0, spf1 = 0, abort0 = 0, abort1 = 0;
+	unsigned long long faults = 0, maps = 0, lat_sum = 0, lat_max = 0;
+	struct fault_worker *workers;
+	struct timeval start, stop, diff;
+	struct stat st;
+	int i, nr, have_spf;
+	double secs;
+
+	argc = parse_options(argc, argv, options,
+			     bench_mem_fault_usage, 0);
+
+	if (!nr_faulters)
+		nr_faulters = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nr_faulters <= 0 || nr_mappers < 0 || size_mb <= 0 ||
+	    map_kb <= 0 || runtime_secs <= 0) {
+		fprintf(stderr, "Invalid thread count, size or runtime\n");
+		return 1;
+	}
+
+	page_size = sysconf(_SC_PAGESIZE);
+	if (file) {
+		file_fd = open(file, O_RDONLY);
+		if (file_fd < 0 || fstat(file_fd, &st))
+			die("can't open %s", file);
+		if (st.st_size < ((off_t)size_mb << 20)) {
+			fprintf(stderr, "%s is smaller than %d MB\n",
+				file, size_mb);
+			return 1;
+		}
+	}
+
+	nr = nr_faulters + nr_mappers;
+	workers = calloc(nr, sizeof(*workers));
+	if (!workers)
+		die("calloc");
+
+	have_spf = !read_vmstat("speculative_pgfault", &spf0) &&
+		   !read_vmstat("speculative_pgfault_abort", &abort0);
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < nr; i++) {
+		workers[i].mapper = i >= nr_faulters;
+		if (pthread_create(&workers[i].thread, NULL,
+				   workers[i].mapper ? map_thread : fault_thread,
+				   &workers[i]))
+			die("pthread_create");
+	}
+
+	sleep(runtime_secs);
+	done = 1;
+
+	for (i = 0; i < nr; i++)
+		pthread_join(workers[i].thread, NULL);
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+	secs = diff.tv_sec + diff.tv_usec / 1000000.0;
+
+	if (have_spf)
+		have_spf = !read_vmstat("speculative_pgfault", &spf1) &&
+			   !read_vmstat("speculative_pgfault_abort", &abort1);
+
+	for (i = 0; i < nr; i++) {
+		if (workers[i].mapper) {
+			maps += workers[i].ops;
+			continue;
+		}
+		faults += workers[i].ops;
+		lat_sum += workers[i].lat_sum;
+		if (workers[i].lat_max > lat_max)
+			lat_max = workers[i].lat_max;
+	}
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %d faulting threads (%d MB %s each), "
+		       "%d mapping threads (%d KB) for %d sec\n\n",
+		       nr_faulters, size_mb, file ? "of file" : "anonymous",
+		       nr_mappers, map_kb, runtime_secs);
+		printf(" %14.0f faults/sec\n", faults / secs);
+		printf(" %14.0f faults/sec per thread\n",
+		       faults / secs / nr_faulters);
+		printf(" %14.2f usecs avg fault latency\n",
+		       faults ? (double)lat_sum / faults / 1000 : 0.0);
+		printf(" %14.1f usecs max fault latency\n", lat_max / 1000.0);
+		if (nr_mappers)
+			printf(" %14.0f mmap+munmap/sec\n", maps / secs);
+		if (have_spf)
+			printf(" %14llu speculative faults, %llu fell back\n",
+			       spf1 - spf0, abort1 - abort0);
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%.0f %.1f\n", faults / secs, lat_max / 1000.0);
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	if (file_fd >= 0)
+		close(file_fd);
+	free(workers);
+	return 0;
+}
@@ -0,0 +1,24 @@
+
+MEMCPY_FN(__memcpy_arm,
+	"arm-ldm",
+	"ldm/stm memcpy() in arch/arm/lib/memcpy.S")
+
+MEMCPY_FN(__memcpy_neon_pld128,
+	"arm-neon-pld128",
+	"NEON memcpy() in arch/arm/lib/memcpy_neon.S, prefetch 128 bytes ahead")
+
+MEMCPY_FN(__memcpy_neon_pld192,
+	"arm-neon-pld192",
+	"NEON memcpy() in arch/arm/lib/memcpy_neon.S, prefetch 192 bytes ahead")
+
+MEMCPY_FN(__memcpy_neon_pld256,
+	"arm-neon-pld256",
+	"NEON memcpy() in arch/arm/lib/memcpy_neon.S, prefetch 256 bytes ahead")
+
+MEMCPY_FN(__memcpy_neon_pld320,
+	"arm-neon-pld320",
+	"NEON memcpy() in arch/arm/lib/memcpy_neon.S, prefetch 320 bytes ahead")
+
+MEMCPY_FN(__memcpy_neon_pld448,
+	"arm-neon-pld448",
+	"NEON memcpy() in arch/arm/lib/memcpy_neon.S, prefetch 448 bytes ahead")
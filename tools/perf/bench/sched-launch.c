@@ -0,0 +1,271 @@
+/*
+ *
+ * sched-launch.c
+ *
+ * launch: Replay of application launches against background load
+ *
+ * A launch is replayed as a list of phases, each burning a fixed amount
+ * of cpu time and then sleeping for a fixed time, the way an application
+ * start alternates between computing and waiting for I/O.  The launches
+ * run one after another while background threads keep every cpu busy.
+ * Each thread can be moved into a cpu cgroup first, so that the effect of
+ * the group's shares and bandwidth settings (cpu.cfs_quota_us,
+ * cpu.cfs_bg_quota_us) on launch time can be measured.
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/syscall.h>
+
+#define MAX_PHASES	64
+
+static int nr_background = 4;
+static int nr_launches = 10;
+static int gap_msecs = 200;
+static const char *bg_cgroup;
+static const char *fg_cgroup;
+/* run:sleep usecs per phase, roughly the shape of an application start */
+static const char *profile = "4000:2000,12000:1000,3000:4000,20000:500,6000:0";
+
+static const struct option options[] = {
+	OPT_INTEGER('b', "background", &nr_background,
+		    "Specify number of background threads"),
+	OPT_STRING('B', "bg-cgroup", &bg_cgroup, "dir",
+		   "Move the background threads into this cpu cgroup"),
+	OPT_STRING('F', "fg-cgroup", &fg_cgroup, "dir",
+		   "Move the launching thread into this cpu cgroup"),
+	OPT_INTEGER('l', "launches", &nr_launches,
+		    "Specify number of launches to replay"),
+	OPT_INTEGER('g', "gap", &gap_msecs,
+		    "Specify msecs to wait between launches"),
+	OPT_STRING('p', "profile", &profile, "run:sleep,...",
+		   "Specify the phases of a launch in usecs"),
+	OPT_END()
+};
+
+static const char * const bench_sched_launch_usage[] = {
+	"perf bench sched launch <options>",
+	NULL
+};
+
+struct launch_phase {
+	unsigned long long run;
+	unsigned long long sleep;
+};
+
+static struct launch_phase phases[MAX_PHASES];
+static int nr_phases;
+
+struct bg_worker {
+	pthread_t	thread;
+	unsigned long long loops;
+};
+
+static volatile int done;
+
+static unsigned long long clock_usecs(clockid_t clk)
+{
+	struct timespec ts;
+
+	clock_gettime(clk, &ts);
+	return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static void join_cgroup(const char *dir)
+{
+	char path[PATH_MAX];
+	FILE *f;
+
+	if (!dir)
+		return;
+
+	snprintf(path, sizeof(path), "%s/tasks", dir);
+	f = fopen(path, "w");
+	if (!f)
+		die("can't open %s", path);
+	fprintf(f, "%ld\n", (long)syscall(__NR_gettid));
+	if (fclose(f))
+		die("can't join cgroup %s", dir);
+}
+
+static int parse_profile(const char *str)
+{
+	const char *p = str;
+	char *end;
+
+	nr_phases = 0;
+	while (*p) {
+		if (nr_phases == MAX_PHASES)
+			return -1;
+
+		phases[nr_phases].run = strtoull(p, &end, 10);
+		if (end == p || *end != ':')
+			return -1;
+		p = end + 1;
+
+		phases[nr_phases].sleep = strtoull(p, &end, 10);
+		if (end == p || (*end && *end != ','))
+			return -1;
+		p = *end ? end + 1 : end;
+
+		nr_phases++;
+	}
+
+	return nr_phases ? 0 : -1;
+}
+
+static void *bg_thread(void *arg)
+{
+	struct bg_worker *w = arg;
+
+	join_cgroup(bg_cgroup);
+	while (!done)
+		w->loops++;
+
+	return NULL;
+}
+
+/* Burn 'usecs' of this thread's cpu time, however long that takes */
+static void burn_cpu(unsigned long long usecs)
+{
+	unsigned long long until;
+
+	until = clock_usecs(CLOCK_THREAD_CPUTIME_ID) + usecs;
+	while (clock_usecs(CLOCK_THREAD_CPUTIME_ID) < until)
+		;
+}
+
+static unsigned long long replay_launch(void)
+{
+	unsigned long long start = clock_usecs(CLOCK_MONOTONIC);
+	struct timespec ts;
+	int i;
+
+	for (i = 0; i < nr_phases; i++) {
+		burn_cpu(phases[i].run);
+		if (!phases[i].sleep)
+			continue;
+		ts.tv_sec = phases[i].sleep / 1000000;
+		ts.tv_nsec = (phases[i].sleep % 1000000) * 1000;
+		nanosleep(&ts, NULL);
+	}
+
+	return clock_usecs(CLOCK_MONOTONIC) - start;
+}
+
+static int cmp_ull(const void *a, const void *b)
+{
+	unsigned long long x = *(const unsigned long long *)a;
+	unsigned long long y = *(const unsigned long long *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+int bench_sched_launch(int argc, const char **argv,
+		       const char *prefix __used)
+{
+	struct bg_worker *workers = NULL;
+	unsigned long long *times, ideal = 0, sum = 0, loops = 0;
+	struct timeval start, stop, diff;
+	struct timespec gap;
+	double secs;
+	int i;
+
+	argc = parse_options(argc, argv, options,
+			     bench_sched_launch_usage, 0);
+
+	if (!parse_profile(profile)) {
+		for (i = 0; i < nr_phases; i++)
+			ideal += phases[i].run + phases[i].sleep;
+	}
+	if (!ideal) {
+		fprintf(stderr, "Invalid launch profile: %s\n", profile);
+		return 1;
+	}
+	if (nr_launches <= 0 || nr_background < 0 || gap_msecs < 0) {
+		fprintf(stderr, "Invalid launch or thread count\n");
+		return 1;
+	}
+
+	times = calloc(nr_launches, sizeof(*times));
+	if (nr_background)
+		workers = calloc(nr_background, sizeof(*workers));
+	if (!times || (nr_background && !workers))
+		die("calloc");
+
+	join_cgroup(fg_cgroup);
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < nr_background; i++) {
+		if (pthread_create(&workers[i].thread, NULL,
+				   bg_thread, &workers[i]))
+			die("pthread_create");
+	}
+
+	gap.tv_sec = gap_msecs / 1000;
+	gap.tv_nsec = (gap_msecs % 1000) * 1000000;
+	for (i = 0; i < nr_launches; i++) {
+		nanosleep(&gap, NULL);
+		times[i] = replay_launch();
+		sum += times[i];
+	}
+
+	done = 1;
+	for (i = 0; i < nr_background; i++) {
+		pthread_join(workers[i].thread, NULL);
+		loops += workers[i].loops;
+	}
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+	secs = diff.tv_sec + diff.tv_usec / 1000000.0;
+
+	qsort(times, nr_launches, sizeof(*times), cmp_ull);
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %d launches of %d phases (%llu usecs unloaded) "
+		       "against %d background threads\n\n",
+		       nr_launches, nr_phases, ideal, nr_background);
+		printf(" %14.1f msecs avg launch time\n",
+		       (double)sum / nr_launches / 1000);
+		printf(" %14.1f msecs min launch time\n",
+		       times[0] / 1000.0);
+		printf(" %14.1f msecs 90th percentile launch time\n",
+		       times[(nr_launches * 9 - 1) / 10] / 1000.0);
+		printf(" %14.1f msecs max launch time\n",
+		       times[nr_launches - 1] / 1000.0);
+		printf(" %14.2f x unloaded launch time (avg)\n",
+		       (double)sum / nr_launches / ideal);
+		if (nr_background)
+			printf(" %14.0f background loops/sec per thread\n",
+			       loops / secs / nr_background);
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%.1f %.1f\n", (double)sum / nr_launches / 1000,
+		       times[nr_launches - 1] / 1000.0);
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	free(workers);
+	free(times);
+	return 0;
+}
@@ -0,0 +1,255 @@
+/*
+ *
+ * sched-mixed.c
+ *
+ * mixed: Benchmark for load tracking of steady and bursty tasks
+ *
+ * Runs a set of always-running threads next to a set of bursty threads
+ * that alternately run and sleep for fixed periods.  The bursty threads
+ * measure how late they are woken after each sleep and count the work
+ * they get done; at the end every thread samples the load contribution
+ * the scheduler tracks for it (se.avg.load_avg_contrib in
+ * /proc/self/task/<tid>/sched, available with CONFIG_SCHED_DEBUG).
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/syscall.h>
+
+static int nr_steady = 2;
+static int nr_bursty = 4;
+static int run_usecs = 2000;
+static int sleep_usecs = 8000;
+static int runtime_secs = 5;
+
+static const struct option options[] = {
+	OPT_INTEGER('s', "steady", &nr_steady,
+		    "Specify number of always-running threads"),
+	OPT_INTEGER('b', "bursty", &nr_bursty,
+		    "Specify number of bursty threads"),
+	OPT_INTEGER('R', "run", &run_usecs,
+		    "Specify usecs a bursty thread runs per period"),
+	OPT_INTEGER('S', "sleep", &sleep_usecs,
+		    "Specify usecs a bursty thread sleeps per period"),
+	OPT_INTEGER('r', "runtime", &runtime_secs,
+		    "Specify benchmark runtime in seconds"),
+	OPT_END()
+};
+
+static const char * const bench_sched_mixed_usage[] = {
+	"perf bench sched mixed <options>",
+	NULL
+};
+
+struct mixed_worker {
+	pthread_t	thread;
+	int		bursty;
+	unsigned long	periods;
+	unsigned long long work;
+	unsigned long long lat_sum;
+	unsigned long long lat_max;
+	long		load_contrib;
+};
+
+static volatile int done;
+
+static unsigned long long now_usecs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+/* Burn cpu until 'until', counting iterations as work done */
+static unsigned long long spin_until(unsigned long long until)
+{
+	unsigned long long work = 0;
+
+	do {
+		work++;
+	} while (!done && now_usecs() < until);
+
+	return work;
+}
+
+static long read_load_contrib(void)
+{
+	char path[64], line[128];
+	long contrib = -1;
+	FILE *f;
+
+	snprintf(path, sizeof(path), "/proc/self/task/%ld/sched",
+		 (long)syscall(__NR_gettid));
+	f = fopen(path, "r");
+	if (!f)
+		return -1;
+
+	while (fgets(line, sizeof(line), f)) {
+		if (!strncmp(line, "se.avg.load_avg_contrib",
+			     strlen("se.avg.load_avg_contrib"))) {
+			sscanf(strchr(line, ':') + 1, "%ld", &contrib);
+			break;
+		}
+	}
+	fclose(f);
+
+	return contrib;
+}
+
+static void *mixed_thread(void *arg)
+{
+	struct mixed_worker *w = arg;
+	unsigned long long start, lat;
+	struct timespec ts;
+
+	while (!done) {
+		if (!w->bursty) {
+			w->work += spin_until(now_usecs() + 1000);
+			continue;
+		}
+
+		w->work += spin_until(now_usecs() + run_usecs);
+
+		ts.tv_sec = sleep_usecs / 1000000;
+		ts.tv_nsec = (sleep_usecs % 1000000) * 1000;
+		start = now_usecs();
+		nanosleep(&ts, NULL);
+		lat = now_usecs() - start;
+		lat = lat > (unsigned long long)sleep_usecs ?
+			lat - sleep_usecs : 0;
+
+		w->lat_sum += lat;
+		if (lat > w->lat_max)
+			w->lat_max = lat;
+		w->periods++;
+	}
+
+	w->load_contrib = read_load_contrib();
+	return NULL;
+}
+
+static void print_class(const char *name, struct mixed_worker *workers,
+			int nr, int bursty, double secs)
+{
+	unsigned long long work = 0, lat_sum = 0, lat_max = 0;
+	unsigned long periods = 0;
+	long contrib = 0;
+	int i, n = 0, have_contrib = 1;
+
+	for (i = 0; i < nr; i++) {
+		struct mixed_worker *w = &workers[i];
+
+		if (w->bursty != bursty)
+			continue;
+		n++;
+		work += w->work;
+		periods += w->periods;
+		lat_sum += w->lat_sum;
+		if (w->lat_max > lat_max)
+			lat_max = w->lat_max;
+		if (w->load_contrib < 0)
+			have_contrib = 0;
+		else
+			contrib += w->load_contrib;
+	}
+	if (!n)
+		return;
+
+	printf(" %-7s threads: %d\n", name, n);
+	printf(" %14.0f loops/sec per thread\n", work / secs / n);
+	if (bursty) {
+		printf(" %14.1f usecs avg wakeup latency\n",
+		       periods ? (double)lat_sum / periods : 0.0);
+		printf(" %14llu usecs max wakeup latency\n", lat_max);
+	}
+	if (have_contrib)
+		printf(" %14ld avg load_avg_contrib\n", contrib / n);
+	else
+		printf(" %14s avg load_avg_contrib\n", "n/a");
+	printf("\n");
+}
+
+int bench_sched_mixed(int argc, const char **argv,
+		      const char *prefix __used)
+{
+	struct mixed_worker *workers;
+	struct timeval start, stop, diff;
+	unsigned long long lat_sum = 0, lat_max = 0;
+	unsigned long periods = 0;
+	double secs;
+	int i, nr;
+
+	argc = parse_options(argc, argv, options,
+			     bench_sched_mixed_usage, 0);
+
+	nr = nr_steady + nr_bursty;
+	if (nr <= 0 || run_usecs <= 0 || sleep_usecs <= 0) {
+		fprintf(stderr, "Invalid thread count or period\n");
+		return 1;
+	}
+
+	workers = calloc(nr, sizeof(*workers));
+	if (!workers)
+		die("calloc");
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < nr; i++) {
+		workers[i].bursty = i >= nr_steady;
+		if (pthread_create(&workers[i].thread, NULL,
+				   mixed_thread, &workers[i]))
+			die("pthread_create");
+	}
+
+	sleep(runtime_secs);
+	done = 1;
+
+	for (i = 0; i < nr; i++)
+		pthread_join(workers[i].thread, NULL);
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+	secs = diff.tv_sec + diff.tv_usec / 1000000.0;
+
+	for (i = 0; i < nr; i++) {
+		lat_sum += workers[i].lat_sum;
+		periods += workers[i].periods;
+		if (workers[i].lat_max > lat_max)
+			lat_max = workers[i].lat_max;
+	}
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %d steady and %d bursty (%d/%d usecs run/sleep) "
+		       "threads for %d sec\n\n", nr_steady, nr_bursty,
+		       run_usecs, sleep_usecs, runtime_secs);
+		print_class("steady", workers, nr, 0, secs);
+		print_class("bursty", workers, nr, 1, secs);
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%.1f %llu\n",
+		       periods ? (double)lat_sum / periods : 0.0, lat_max);
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	free(workers);
+	return 0;
+}
@@ -13,6 +13,7 @@
  * Available subsystem list:
  *  sched ... scheduler and IPC mechanism
  *  mem   ... memory access performance
+ *  futex ... futex performance
  *
  */
 
@@ -42,6 +43,12 @@ static struct bench_suite sched_suites[] = {
 	{ "pipe",
 	  "Flood of communication over pipe() between two processes",
 	  bench_sched_pipe      },
+	{ "mixed",
+	  "Load tracking of steady and bursty (run/sleep) threads",
+	  bench_sched_mixed     },
+	{ "launch",
+	  "Replay of application launches against background load",
+	  bench_sched_launch    },
 	suite_all,
 	{ NULL,
 	  NULL,
@@ -52,6 +59,25 @@ static struct bench_suite mem_suites[] = {
 	{ "memcpy",
 	  "Simple memory copy in various ways",
 	  bench_mem_memcpy },
+	{ "fault",
+	  "Page faults against concurrent mmap and munmap",
+	  bench_mem_fault },
+	suite_all,
+	{ NULL,
+	  NULL,
+	  NULL             }
+};
+
+static struct bench_suite futex_suites[] = {
+	{ "hash",
+	  "Contention on the futex hash table",
+	  bench_futex_hash },
+	{ "wake",
+	  "Wakeup of the waiters of a futex",
+	  bench_futex_wake },
+	{ "requeue",
+	  "Requeueing of the waiters of a futex onto another one",
+	  bench_futex_requeue },
 	suite_all,
 	{ NULL,
 	  NULL,
@@ -71,6 +97,9 @@ static struct bench_subsys subsystems[] = {
 	{ "mem",
 	  "memory access performance",
 	  mem_suites },
+	{ "futex",
+	  "futex performance",
+	  futex_suites },
 	{ "all",		/* sentinel: easy for help */
 	  "test all subsystem (pseudo subsystem)",
 	  NULL },
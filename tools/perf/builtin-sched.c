@@ -12,6 +12,7 @@
 #include "util/trace-event.h"
 
 #include "util/debug.h"
+#include "util/debugfs.h"
 
 #include <sys/prctl.h>
 
@@ -57,6 +58,12 @@ struct task_desc {
 	sem_t			work_done_sem;
 
 	u64			cpu_usage;
+
+	/* per replay run: cpus the task ran on and its wakeup latency */
+	cpu_set_t		cpus_used;
+	u64			nr_wakeups;
+	u64			sum_wakeup_lat;
+	u64			max_wakeup_lat;
 };
 
 enum sched_event_type {
@@ -74,6 +81,8 @@ struct sched_atom {
 	unsigned long		nr;
 	sem_t			*wait_sem;
 	struct task_desc	*wakee;
+	struct sched_atom	*wakee_event;
+	u64			wakeup_time;
 };
 
 static struct task_desc		*pid_to_task[MAX_PID];
@@ -101,6 +110,10 @@ static u64			parent_cpu_usage;
 static u64			runavg_parent_cpu_usage;
 
 static unsigned long		nr_runs;
+static u64			nr_run_wakeups;
+static u64			sum_run_wakeup_lat;
+static u64			max_run_wakeup_lat;
+static int			nr_run_cpus;
 static u64			sum_runtime;
 static u64			sum_fluct;
 static u64			run_avg;
@@ -289,6 +302,7 @@ add_sched_event_wakeup(struct task_desc *task, u64 timestamp,
 	sem_init(wakee_event->wait_sem, 0, 0);
 	wakee_event->specific_wait = 1;
 	event->wait_sem = wakee_event->wait_sem;
+	event->wakee_event = wakee_event;
 
 	nr_wakeup_events++;
 }
@@ -366,20 +380,38 @@ static void add_cross_task_wakeups(void)
 }
 
 static void
-process_sched_event(struct task_desc *this_task __used, struct sched_atom *atom)
+process_sched_event(struct task_desc *this_task, struct sched_atom *atom)
 {
-	int ret = 0;
+	int ret = 0, cpu;
+	u64 lat;
 
 	switch (atom->type) {
 		case SCHED_EVENT_RUN:
+			cpu = sched_getcpu();
+			if (cpu >= 0)
+				CPU_SET(cpu, &this_task->cpus_used);
 			burn_nsecs(atom->duration);
 			break;
 		case SCHED_EVENT_SLEEP:
 			if (atom->wait_sem)
 				ret = sem_wait(atom->wait_sem);
 			BUG_ON(ret);
+			/*
+			 * The waker stamped the atom before posting, so this
+			 * is the time it took the scheduler to run us:
+			 */
+			if (atom->wait_sem && atom->wakeup_time) {
+				lat = get_nsecs() - atom->wakeup_time;
+				this_task->nr_wakeups++;
+				this_task->sum_wakeup_lat += lat;
+				if (lat > this_task->max_wakeup_lat)
+					this_task->max_wakeup_lat = lat;
+				atom->wakeup_time = 0;
+			}
 			break;
 		case SCHED_EVENT_WAKEUP:
+			if (atom->wakee_event)
+				atom->wakee_event->wakeup_time = get_nsecs();
 			if (atom->wait_sem)
 				ret = sem_post(atom->wait_sem);
 			BUG_ON(ret);
@@ -507,9 +539,14 @@ static void wait_for_tasks(void)
 	u64 cpu_usage_0, cpu_usage_1;
 	struct task_desc *task;
 	unsigned long i, ret;
+	cpu_set_t cpus_used;
 
 	start_time = get_nsecs();
 	cpu_usage = 0;
+	nr_run_wakeups = 0;
+	sum_run_wakeup_lat = 0;
+	max_run_wakeup_lat = 0;
+	CPU_ZERO(&cpus_used);
 	pthread_mutex_unlock(&work_done_wait_mutex);
 
 	for (i = 0; i < nr_tasks; i++) {
@@ -532,7 +569,18 @@ static void wait_for_tasks(void)
 		sem_init(&task->work_done_sem, 0, 0);
 		cpu_usage += task->cpu_usage;
 		task->cpu_usage = 0;
+
+		CPU_OR(&cpus_used, &cpus_used, &task->cpus_used);
+		CPU_ZERO(&task->cpus_used);
+		nr_run_wakeups += task->nr_wakeups;
+		sum_run_wakeup_lat += task->sum_wakeup_lat;
+		max_run_wakeup_lat = max(max_run_wakeup_lat,
+					 task->max_wakeup_lat);
+		task->nr_wakeups = 0;
+		task->sum_wakeup_lat = 0;
+		task->max_wakeup_lat = 0;
 	}
+	nr_run_cpus = CPU_COUNT(&cpus_used);
 
 	cpu_usage_1 = get_cpu_usage_nsec_parent();
 	if (!runavg_cpu_usage)
@@ -586,6 +634,13 @@ static void run_one_test(void)
 	printf("cpu: %0.2f / %0.2f",
 		(double)cpu_usage/1e6, (double)runavg_cpu_usage/1e6);
 
+	printf(", cpus: %d", nr_run_cpus);
+
+	printf(", lat: %0.3f / %0.3f",
+		nr_run_wakeups ?
+			(double)sum_run_wakeup_lat/nr_run_wakeups/1e6 : 0.0,
+		(double)max_run_wakeup_lat/1e6);
+
 #if 0
 	/*
 	 * rusage statistics done by the parent, these are less
@@ -1775,9 +1830,186 @@ static void __cmd_replay(void)
 		run_one_test();
 }
 
+/*
+ * lathist: show the kernel's wakeup latency histograms
+ * (<debugfs>/sched_lat_hist, CONFIG_SCHED_LATENCY_HIST)
+ */
+#define LATHIST_ENTRY		"sched_lat_hist"
+#define LATHIST_MAX_BUCKETS	64
+#define LATHIST_BAR_WIDTH	40
+
+struct lathist_entry {
+	char			*name;
+	unsigned int		buckets[LATHIST_MAX_BUCKETS];
+};
+
+static int			lathist_interval;
+static bool			lathist_reset;
+static const char		*lathist_group;
+static int			lathist_nr_buckets;
+
+static FILE *lathist_open(const char *mode)
+{
+	const char *debugfs = debugfs_find_mountpoint();
+	char path[MAX_PATH];
+	FILE *f;
+
+	if (!debugfs)
+		die("debugfs is not mounted\n");
+
+	snprintf(path, sizeof(path), "%s/%s", debugfs, LATHIST_ENTRY);
+	f = fopen(path, mode);
+	if (!f)
+		die("Can't open %s: %s (is CONFIG_SCHED_LATENCY_HIST set?)\n",
+		    path, strerror(errno));
+	return f;
+}
+
+static int lathist_read(struct lathist_entry **entries)
+{
+	struct lathist_entry *e, *list = NULL;
+	char line[BUFSIZ], *p, *end;
+	int i, nr = 0, version = 0;
+	FILE *f = lathist_open("r");
+
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, "version %d", &version) == 1)
+			continue;
+		if (sscanf(line, "buckets %d", &lathist_nr_buckets) == 1) {
+			if (lathist_nr_buckets > LATHIST_MAX_BUCKETS)
+				die("Too many histogram buckets\n");
+			continue;
+		}
+		if (version != 1)
+			die("Unknown %s version %d\n", LATHIST_ENTRY, version);
+
+		list = realloc(list, (nr + 1) * sizeof(*list));
+		BUG_ON(!list);
+		e = &list[nr++];
+		memset(e, 0, sizeof(*e));
+
+		/* "cpu<N> <buckets>" or "group <buckets> <path>" */
+		p = strchr(line, ' ');
+		BUG_ON(!p);
+		*p++ = '\0';
+		for (i = 0; i < lathist_nr_buckets; i++) {
+			e->buckets[i] = strtoul(p, &end, 10);
+			p = end;
+		}
+		if (!strcmp(line, "group")) {
+			p += strspn(p, " ");
+			p[strcspn(p, "\n")] = '\0';
+			e->name = strdup(p);
+		} else {
+			e->name = strdup(line);
+		}
+	}
+	fclose(f);
+
+	*entries = list;
+	return nr;
+}
+
+/* Upper bound of a bucket in usecs, bucket n covers [2^(n-1), 2^n) */
+static unsigned long long lathist_bucket_max(int bucket)
+{
+	return 1ULL << bucket;
+}
+
+static void lathist_print(struct lathist_entry *e)
+{
+	unsigned long long total = 0, sum = 0, p50 = 0, p99 = 0;
+	unsigned int max_count = 0;
+	char bar[LATHIST_BAR_WIDTH + 1];
+	int i, len;
+
+	for (i = 0; i < lathist_nr_buckets; i++) {
+		total += e->buckets[i];
+		if (e->buckets[i] > max_count)
+			max_count = e->buckets[i];
+	}
+	if (!total)
+		return;
+
+	for (i = 0; i < lathist_nr_buckets; i++) {
+		sum += e->buckets[i];
+		if (!p50 && sum * 2 >= total)
+			p50 = lathist_bucket_max(i);
+		if (!p99 && sum * 100 >= total * 99)
+			p99 = lathist_bucket_max(i);
+	}
+
+	printf(" %s: %llu wakeups, p50 < %llu usecs, p99 < %llu usecs\n",
+	       e->name, total, p50, p99);
+
+	for (i = 0; i < lathist_nr_buckets; i++) {
+		if (!e->buckets[i])
+			continue;
+
+		len = (unsigned long long)e->buckets[i] * LATHIST_BAR_WIDTH /
+			max_count;
+		memset(bar, '#', len);
+		bar[len] = '\0';
+
+		if (i == lathist_nr_buckets - 1)
+			printf("   %8llu -          usecs | %10u | %s\n",
+			       lathist_bucket_max(i - 1), e->buckets[i], bar);
+		else
+			printf("   %8llu - %8llu usecs | %10u | %s\n",
+			       i ? lathist_bucket_max(i - 1) : 0,
+			       lathist_bucket_max(i), e->buckets[i], bar);
+	}
+	printf("\n");
+}
+
+static void __cmd_lathist(void)
+{
+	struct lathist_entry *before = NULL, *after;
+	int i, j, k, nr, nr_before = 0;
+	FILE *f;
+
+	if (lathist_reset) {
+		f = lathist_open("w");
+		fputs("0\n", f);
+		fclose(f);
+		return;
+	}
+
+	if (lathist_interval) {
+		nr_before = lathist_read(&before);
+		sleep(lathist_interval);
+	}
+	nr = lathist_read(&after);
+
+	/* Show only what happened during the interval */
+	for (i = 0; i < nr; i++) {
+		for (j = 0; j < nr_before; j++) {
+			if (strcmp(after[i].name, before[j].name))
+				continue;
+			for (k = 0; k < lathist_nr_buckets; k++)
+				after[i].buckets[k] -= before[j].buckets[k];
+			break;
+		}
+	}
+
+	for (i = 0; i < nr; i++) {
+		if (lathist_group && (!strncmp(after[i].name, "cpu", 3) ||
+				      !strstr(after[i].name, lathist_group)))
+			continue;
+		lathist_print(&after[i]);
+	}
+
+	for (i = 0; i < nr_before; i++)
+		free(before[i].name);
+	for (i = 0; i < nr; i++)
+		free(after[i].name);
+	free(before);
+	free(after);
+}
+
 
 static const char * const sched_usage[] = {
-	"perf sched [<options>] {record|latency|map|replay|script}",
+	"perf sched [<options>] {record|latency|lathist|map|replay|script}",
 	NULL
 };
 
@@ -1823,6 +2055,21 @@ static const struct option replay_options[] = {
 	OPT_END()
 };
 
+static const char * const lathist_usage[] = {
+	"perf sched lathist [<options>]",
+	NULL
+};
+
+static const struct option lathist_options[] = {
+	OPT_INTEGER('s', "sleep", &lathist_interval,
+		    "show only the wakeups of the next N seconds"),
+	OPT_STRING('G', "group", &lathist_group, "path",
+		   "show only the cpu cgroups whose path contains this"),
+	OPT_BOOLEAN('r', "reset", &lathist_reset,
+		    "clear the histograms"),
+	OPT_END()
+};
+
 static void setup_sorting(void)
 {
 	char *tmp, *tok, *str = strdup(sort_order);
@@ -1893,6 +2140,18 @@ int cmd_sched(int argc, const char **argv, const char *prefix __used)
 	if (!strcmp(argv[0], "script"))
 		return cmd_script(argc, argv, prefix);
 
+	/*
+	 * Reads the kernel's histograms, no trace involved:
+	 */
+	if (!strcmp(argv[0], "lathist")) {
+		argc = parse_options(argc, argv, lathist_options,
+				     lathist_usage, 0);
+		if (argc)
+			usage_with_options(lathist_usage, lathist_options);
+		__cmd_lathist();
+		return 0;
+	}
+
 	symbol__init();
 	if (!strncmp(argv[0], "rec", 3)) {
 		return __cmd_record(argc, argv);
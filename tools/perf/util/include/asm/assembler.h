@@ -0,0 +1,18 @@
+#ifndef PERF_ASM_ASSEMBLER_H
+#define PERF_ASM_ASSEMBLER_H
+
+/* assembler.h ... dummy header file for including arch/arm/lib/memcpy.S */
+
+#ifndef __ARMEB__
+#define pull		lsr
+#define push		lsl
+#else
+#define pull		lsl
+#define push		lsr
+#endif
+
+#define PLD(code...)	code
+#define CALGN(code...)
+#define W(instr)	instr
+
+#endif	/* PERF_ASM_ASSEMBLER_H */
@@ -0,0 +1,263 @@
+/* $(CROSS_COMPILE)cc -Wall -Wextra -O2 -o swap-stress swap-stress.c -lpthread */
+
+/*
+ * Pushes anonymous memory out to swap and faults it back in from several
+ * threads at once, and reports the swap-out and swap-in rates in pages
+ * per second as counted by pswpout and pswpin in /proc/vmstat.
+ *
+ * Each thread owns a region of its own.  With -r, every pass first has
+ * the whole process reclaimed through /proc/self/reclaim (which needs
+ * CONFIG_PROCESS_RECLAIM) and then has the threads touch their regions
+ * again.  Without it, the regions have to be made larger than the memory
+ * available so that the threads swap each other out while they touch
+ * their regions.  The contents of every page are checked when it comes
+ * back.
+ *
+ *	swap-stress [-t threads] [-m MB per thread] [-p passes] [-r]
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+static unsigned int nr_threads = 4;
+static unsigned int region_mb = 64;
+static unsigned int passes = 5;
+static int use_reclaim;
+
+static size_t page_size;
+static size_t region_pages;
+static pthread_barrier_t barrier;
+static volatile int stop;
+
+struct stress_thread {
+	pthread_t	thread;
+	unsigned int	id;
+	unsigned long	*region;
+	unsigned long	errors;
+};
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int read_vmstat(const char *name, unsigned long long *val)
+{
+	char key[64];
+	unsigned long long v;
+	FILE *f;
+	int ret = -1;
+
+	f = fopen("/proc/vmstat", "r");
+	if (!f)
+		return -1;
+	while (fscanf(f, "%63s %llu", key, &v) == 2) {
+		if (!strcmp(key, name)) {
+			*val = v;
+			ret = 0;
+			break;
+		}
+	}
+	fclose(f);
+	return ret;
+}
+
+static int reclaim_self(void)
+{
+	int fd, ret = 0;
+
+	fd = open("/proc/self/reclaim", O_WRONLY);
+	if (fd < 0)
+		return -1;
+	if (write(fd, "anon", 4) != 4)
+		ret = -1;
+	close(fd);
+	return ret;
+}
+
+/* Every word of a page holds something that is neither zero nor shared */
+static unsigned long pattern(unsigned int id, size_t page, unsigned int pass)
+{
+	return ((unsigned long)id << 24) ^ (page << 4) ^ pass ^ 0x5a5a5a5aUL;
+}
+
+static void fill_page(unsigned long *p, unsigned long val)
+{
+	size_t i;
+
+	for (i = 0; i < page_size / sizeof(long); i += 16)
+		p[i] = val + i;
+}
+
+static int check_page(unsigned long *p, unsigned long val)
+{
+	size_t i;
+
+	for (i = 0; i < page_size / sizeof(long); i += 16)
+		if (p[i] != val + i)
+			return -1;
+	return 0;
+}
+
+static void *stress_thread(void *arg)
+{
+	struct stress_thread *t = arg;
+	size_t words = page_size / sizeof(long);
+	unsigned int pass = 0;
+	size_t i;
+
+	for (i = 0; i < region_pages; i++)
+		fill_page(t->region + i * words, pattern(t->id, i, pass));
+	pthread_barrier_wait(&barrier);
+
+	for (;;) {
+		pthread_barrier_wait(&barrier);
+		if (stop)
+			break;
+
+		/* Fault every page back in, check it and dirty it again */
+		for (i = 0; i < region_pages; i++) {
+			unsigned long *p = t->region + i * words;
+
+			if (check_page(p, pattern(t->id, i, pass)))
+				t->errors++;
+			fill_page(p, pattern(t->id, i, pass + 1));
+		}
+		pass++;
+		pthread_barrier_wait(&barrier);
+	}
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long long out0, out1, in0, in1;
+	double t0, t1, t_out = 0, t_in = 0;
+	unsigned long long pages_out = 0, pages_in = 0;
+	unsigned long errors = 0;
+	struct stress_thread *threads;
+	unsigned int i, pass;
+	int c;
+
+	while ((c = getopt(argc, argv, "t:m:p:r")) != -1) {
+		switch (c) {
+		case 't':
+			nr_threads = strtoul(optarg, NULL, 0);
+			break;
+		case 'm':
+			region_mb = strtoul(optarg, NULL, 0);
+			break;
+		case 'p':
+			passes = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			use_reclaim = 1;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-t threads] "
+				"[-m MB per thread] [-p passes] [-r]\n",
+				argv[0]);
+			return 1;
+		}
+	}
+
+	if (!nr_threads || !region_mb || !passes) {
+		fprintf(stderr, "threads, size and passes must not be 0\n");
+		return 1;
+	}
+	if (read_vmstat("pswpout", &out0) || read_vmstat("pswpin", &in0)) {
+		fprintf(stderr, "can't read /proc/vmstat\n");
+		return 1;
+	}
+
+	page_size = sysconf(_SC_PAGESIZE);
+	region_pages = ((size_t)region_mb << 20) / page_size;
+
+	threads = calloc(nr_threads, sizeof(*threads));
+	if (!threads)
+		return 1;
+	pthread_barrier_init(&barrier, NULL, nr_threads + 1);
+
+	for (i = 0; i < nr_threads; i++) {
+		threads[i].id = i;
+		threads[i].region = mmap(NULL, region_pages * page_size,
+					 PROT_READ | PROT_WRITE,
+					 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (threads[i].region == MAP_FAILED) {
+			perror("mmap");
+			return 1;
+		}
+		if (pthread_create(&threads[i].thread, NULL, stress_thread,
+				   &threads[i])) {
+			perror("pthread_create");
+			return 1;
+		}
+	}
+
+	/* Wait for the regions to be populated */
+	pthread_barrier_wait(&barrier);
+
+	for (pass = 0; pass < passes; pass++) {
+		if (use_reclaim) {
+			read_vmstat("pswpout", &out0);
+			t0 = now();
+			if (reclaim_self()) {
+				fprintf(stderr, "can't write /proc/self/reclaim: "
+					"%s\n", strerror(errno));
+				return 1;
+			}
+			t1 = now();
+			read_vmstat("pswpout", &out1);
+			pages_out += out1 - out0;
+			t_out += t1 - t0;
+		}
+
+		read_vmstat("pswpout", &out0);
+		read_vmstat("pswpin", &in0);
+		t0 = now();
+		pthread_barrier_wait(&barrier);
+		pthread_barrier_wait(&barrier);
+		t1 = now();
+		read_vmstat("pswpout", &out1);
+		read_vmstat("pswpin", &in1);
+		pages_in += in1 - in0;
+		t_in += t1 - t0;
+		if (!use_reclaim) {
+			/* Both directions happen during the touch phase */
+			pages_out += out1 - out0;
+			t_out += t1 - t0;
+		}
+	}
+
+	stop = 1;
+	pthread_barrier_wait(&barrier);
+	for (i = 0; i < nr_threads; i++) {
+		pthread_join(threads[i].thread, NULL);
+		errors += threads[i].errors;
+	}
+
+	printf("%u threads, %u MB each, %u passes%s\n", nr_threads,
+	       region_mb, passes, use_reclaim ? ", process reclaim" : "");
+	printf("swap out: %10llu pages %10.0f pages/s\n", pages_out,
+	       t_out > 0 ? pages_out / t_out : 0.0);
+	printf("swap in:  %10llu pages %10.0f pages/s\n", pages_in,
+	       t_in > 0 ? pages_in / t_in : 0.0);
+	if (errors)
+		printf("%lu pages came back corrupted\n", errors);
+
+	return errors ? 1 : 0;
+}
@@ -0,0 +1,265 @@
+/* $(CROSS_COMPILE)cc -Wall -Wextra -O2 -o vmpressure-latency vmpressure-latency.c -lpthread */
+
+/*
+ * Measures how long it takes from the start of reclaim to the delivery of
+ * a memory.pressure_level notification.
+ *
+ * The program moves itself into the given memory cgroup, registers an
+ * eventfd for the requested level and then faults in anonymous memory
+ * until it is notified or has touched the given amount.  A sampler thread
+ * watches the cgroup's memory.failcnt, which goes up whenever a charge
+ * hits the limit and the cgroup has to reclaim, and the pgscan counters
+ * in /proc/vmstat, which go up when kswapd or the page allocator reclaim.
+ * The delay is the time from the first change of either to the wakeup of
+ * the thread that waits on the eventfd.  For "medium" and "critical" it
+ * includes the time reclaim takes to get that hard.
+ *
+ * The cgroup needs a limit well below the amount touched, e.g.
+ *
+ *	echo 32M > /sys/fs/cgroup/memory/foo/memory.limit_in_bytes
+ *	vmpressure-latency -c /sys/fs/cgroup/memory/foo -m 64
+ *
+ *	vmpressure-latency [-c cgroup] [-l level] [-m MB] [-n runs]
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+
+static const char *cgroup = "/sys/fs/cgroup/memory";
+static const char *level = "low";
+static unsigned int size_mb = 256;
+static unsigned int runs = 5;
+
+static volatile int notified;
+static volatile int stop;
+static double t_reclaim, t_notify;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int write_file(const char *name, const char *buf)
+{
+	char path[PATH_MAX];
+	int fd, ret = 0;
+
+	snprintf(path, sizeof(path), "%s/%s", cgroup, name);
+	fd = open(path, O_WRONLY);
+	if (fd < 0)
+		return -1;
+	if (write(fd, buf, strlen(buf)) != (ssize_t)strlen(buf))
+		ret = -1;
+	close(fd);
+	return ret;
+}
+
+/* Sum of memory.failcnt and all pgscan_* counters in /proc/vmstat */
+static unsigned long long reclaim_events(void)
+{
+	unsigned long long v, sum = 0;
+	char path[PATH_MAX], key[64];
+	FILE *f;
+
+	snprintf(path, sizeof(path), "%s/memory.failcnt", cgroup);
+	f = fopen(path, "r");
+	if (f) {
+		if (fscanf(f, "%llu", &v) == 1)
+			sum += v;
+		fclose(f);
+	}
+
+	f = fopen("/proc/vmstat", "r");
+	if (!f)
+		return sum;
+	while (fscanf(f, "%63s %llu", key, &v) == 2)
+		if (!strncmp(key, "pgscan", 6))
+			sum += v;
+	fclose(f);
+	return sum;
+}
+
+static void *sampler_thread(void *arg)
+{
+	unsigned long long base = *(unsigned long long *)arg;
+	struct timespec ts = { 0, 100000 };
+
+	while (!stop) {
+		if (reclaim_events() != base) {
+			t_reclaim = now();
+			return NULL;
+		}
+		nanosleep(&ts, NULL);
+	}
+	/* Notified before the change was sampled: count it as no delay */
+	if (reclaim_events() != base)
+		t_reclaim = now();
+	return NULL;
+}
+
+static void *listener_thread(void *arg)
+{
+	int efd = *(int *)arg;
+	uint64_t cnt;
+
+	if (read(efd, &cnt, sizeof(cnt)) == sizeof(cnt)) {
+		t_notify = now();
+		notified = 1;
+	}
+	return NULL;
+}
+
+static int register_event(int efd)
+{
+	char path[PATH_MAX], buf[64];
+	int cfd, ret;
+
+	snprintf(path, sizeof(path), "%s/memory.pressure_level", cgroup);
+	cfd = open(path, O_RDONLY);
+	if (cfd < 0)
+		return -1;
+	snprintf(buf, sizeof(buf), "%d %d %s", efd, cfd, level);
+	ret = write_file("cgroup.event_control", buf);
+	close(cfd);
+	return ret;
+}
+
+/* One run: returns the delay in seconds, or -1 if nothing was measured */
+static double run_once(size_t page_size)
+{
+	size_t len = (size_t)size_mb << 20, off;
+	pthread_t sampler, listener;
+	unsigned long long base;
+	char *p;
+	int efd;
+
+	notified = stop = 0;
+	t_reclaim = t_notify = 0;
+
+	efd = eventfd(0, 0);
+	if (efd < 0) {
+		perror("eventfd");
+		exit(1);
+	}
+	if (register_event(efd)) {
+		fprintf(stderr, "can't register for %s in %s: %s\n",
+			level, cgroup, strerror(errno));
+		exit(1);
+	}
+
+	p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED) {
+		perror("mmap");
+		exit(1);
+	}
+
+	base = reclaim_events();
+	if (pthread_create(&sampler, NULL, sampler_thread, &base) ||
+	    pthread_create(&listener, NULL, listener_thread, &efd)) {
+		perror("pthread_create");
+		exit(1);
+	}
+
+	for (off = 0; off < len && !notified; off += page_size)
+		p[off] = 1;
+
+	/* Give a late notification a moment before giving up on it */
+	if (!notified)
+		sleep(1);
+
+	stop = 1;
+	pthread_join(sampler, NULL);
+	if (!notified)
+		pthread_cancel(listener);
+	pthread_join(listener, NULL);
+
+	munmap(p, len);
+	/* Closing the eventfd unregisters the event */
+	close(efd);
+
+	if (!notified || !t_reclaim)
+		return -1;
+	/* The sampler may see the counters change after the notification */
+	return t_notify > t_reclaim ? t_notify - t_reclaim : 0;
+}
+
+int main(int argc, char **argv)
+{
+	double delay, sum = 0, min = 0, max = 0;
+	unsigned int i, measured = 0;
+	char buf[32];
+	int c;
+
+	while ((c = getopt(argc, argv, "c:l:m:n:")) != -1) {
+		switch (c) {
+		case 'c':
+			cgroup = optarg;
+			break;
+		case 'l':
+			level = optarg;
+			break;
+		case 'm':
+			size_mb = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			runs = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-c cgroup] [-l level] "
+				"[-m MB] [-n runs]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (!size_mb || !runs) {
+		fprintf(stderr, "size and runs must not be 0\n");
+		return 1;
+	}
+
+	snprintf(buf, sizeof(buf), "%d", (int)getpid());
+	if (write_file("tasks", buf)) {
+		fprintf(stderr, "can't join %s: %s\n", cgroup,
+			strerror(errno));
+		return 1;
+	}
+
+	for (i = 0; i < runs; i++) {
+		delay = run_once(sysconf(_SC_PAGESIZE));
+		if (delay < 0) {
+			printf("run %u: no %s notification after %u MB\n",
+			       i, level, size_mb);
+			continue;
+		}
+		printf("run %u: %8.3f ms\n", i, delay * 1000);
+		if (!measured || delay < min)
+			min = delay;
+		if (!measured || delay > max)
+			max = delay;
+		sum += delay;
+		measured++;
+	}
+
+	if (!measured)
+		return 1;
+	printf("%s: %u runs, delay min %.3f avg %.3f max %.3f ms\n", level,
+	       measured, min * 1000, sum / measured * 1000, max * 1000);
+	return 0;
+}